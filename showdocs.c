@@ -15,6 +15,7 @@
 
 #ifndef _WIN32
 #define _POSIX_C_SOURCE 200112L
+#define _XOPEN_SOURCE 600 // SA_RESTART
 #endif
 
 #include <stdio.h>
@@ -24,6 +25,11 @@
 #include <ctype.h>
 #include <libgen.h>
 #include <stdarg.h>
+#include <errno.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
 
 // Version information - can be overridden at compile time
 #ifndef VERSION
@@ -54,8 +60,6 @@ typedef int socklen_t;
 #include <arpa/inet.h>
 #include <strings.h>
 #include <sys/socket.h>
-#include <sys/types.h>
-#include <sys/stat.h>
 #include <sys/time.h>
 #define INVALID_SOCKET -1
 #define SOCKET_ERROR -1
@@ -66,6 +70,8 @@ typedef int socklen_t;
 #define BUFFER_SIZE 4096
 #define MAX_PATH_LEN 512
 #define MAX_CMD_LEN 1024
+#define ACCESS_LOG_DEFAULT_RECORDS 65536
+#define ACCESS_LOG_MAX_RECORDS (8 * 1024 * 1024)
 
 // Global variables for signal handling
 static volatile int g_run = 1;
@@ -73,6 +79,7 @@ static volatile int g_run = 1;
 static SOCKET g_server_sock = INVALID_SOCKET;
 #else
 static int g_server_sock = -1;
+static volatile sig_atomic_t g_trace_toggle = 0;
 #endif
 
 // Log levels
@@ -103,8 +110,8 @@ void get_timestamp(char *buffer, size_t max_len)
 #endif
 }
 
-// Logging function with timestamp and level
-void log_message(LogLevel level, const char *format, ...)
+// Logging function with timestamp and level, taking a va_list
+void vlog_message(LogLevel level, const char *format, va_list args)
 {
     char timestamp[32];
     get_timestamp(timestamp, sizeof(timestamp));
@@ -130,14 +137,18 @@ void log_message(LogLevel level, const char *format, ...)
     }
 
     printf("[%s] [%s] ", timestamp, level_str);
+    vprintf(format, args);
+    printf("\n");
+    fflush(stdout);
+}
 
+// Logging function with timestamp and level
+void log_message(LogLevel level, const char *format, ...)
+{
     va_list args;
     va_start(args, format);
-    vprintf(format, args);
+    vlog_message(level, format, args);
     va_end(args);
-
-    printf("\n");
-    fflush(stdout);
 }
 
 // Configuration structure
@@ -150,10 +161,27 @@ typedef struct
     char exec_start_win[MAX_CMD_LEN];
     char exec_start_linux[MAX_CMD_LEN];
     char exec_start_macos[MAX_CMD_LEN];
+    int manifest_enabled;
+    int warmup_files;
+    char manifest_file[MAX_PATH_LEN];
+    int rate_limit;
+    int rate_burst;
+    char rate_limit_allow[MAX_CMD_LEN];
+    char access_log[MAX_PATH_LEN];
+    int access_log_records;
+    int trace_enabled;
+    int trace_sample;
+    char trace_file[MAX_PATH_LEN];
+    int cache_size;
+    int cache_max_file_size;
+    int auto_sidebar;
 } Config; // Forward declarations
 
-void send_http_response(int client_sock, const char *status_line, const char *filename,
-                        const char *date_str, const char *root_dir);
+typedef struct Arena Arena;
+long send_http_response(int client_sock, const char *status_line, const char *filename,
+                        const char *date_str, const char *root_dir, Arena *arena);
+long send_buffer_response(int client_sock, const char *status_line, const char *content_type,
+                          const char *data, size_t size, const char *date_str, Arena *arena);
 
 // Display version information
 void print_version(void)
@@ -278,6 +306,61 @@ int parse_config(const char *config_file, Config *config)
                 strncpy(config->exec_start_macos, value, MAX_CMD_LEN - 1);
                 config->exec_start_macos[MAX_CMD_LEN - 1] = 0;
             }
+            else if (strcasecmp(key, "Manifest") == 0)
+            {
+                config->manifest_enabled = atoi(value);
+            }
+            else if (strcasecmp(key, "WarmupFiles") == 0)
+            {
+                config->warmup_files = atoi(value);
+            }
+            else if (strcasecmp(key, "RateLimit") == 0)
+            {
+                config->rate_limit = atoi(value);
+            }
+            else if (strcasecmp(key, "RateBurst") == 0)
+            {
+                config->rate_burst = atoi(value);
+            }
+            else if (strcasecmp(key, "RateLimitAllow") == 0)
+            {
+                strncpy(config->rate_limit_allow, value, MAX_CMD_LEN - 1);
+                config->rate_limit_allow[MAX_CMD_LEN - 1] = 0;
+            }
+            else if (strcasecmp(key, "AccessLog") == 0)
+            {
+                strncpy(config->access_log, value, MAX_PATH_LEN - 1);
+                config->access_log[MAX_PATH_LEN - 1] = 0;
+            }
+            else if (strcasecmp(key, "AccessLogRecords") == 0)
+            {
+                config->access_log_records = atoi(value);
+            }
+            else if (strcasecmp(key, "AutoSidebar") == 0)
+            {
+                config->auto_sidebar = atoi(value);
+            }
+            else if (strcasecmp(key, "CacheSize") == 0)
+            {
+                config->cache_size = atoi(value);
+            }
+            else if (strcasecmp(key, "CacheMaxFileSize") == 0)
+            {
+                config->cache_max_file_size = atoi(value);
+            }
+            else if (strcasecmp(key, "Trace") == 0)
+            {
+                config->trace_enabled = atoi(value);
+            }
+            else if (strcasecmp(key, "TraceSample") == 0)
+            {
+                config->trace_sample = atoi(value);
+            }
+            else if (strcasecmp(key, "TraceFile") == 0)
+            {
+                strncpy(config->trace_file, value, MAX_PATH_LEN - 1);
+                config->trace_file[MAX_PATH_LEN - 1] = 0;
+            }
         }
     }
 
@@ -307,6 +390,22 @@ void get_config_filename(const char *argv0, char *config_file, size_t max_len)
     }
 
     snprintf(config_file, max_len, "%s.ini", exe_path);
+}
+
+// Derive the manifest filename from the config filename
+void get_manifest_filename(const char *config_file, char *manifest_file, size_t max_len)
+{
+    char base[MAX_PATH_LEN];
+    strncpy(base, config_file, MAX_PATH_LEN - 1);
+    base[MAX_PATH_LEN - 1] = 0;
+
+    char *ext = strrchr(base, '.');
+    if (ext && (strcasecmp(ext, ".ini") == 0))
+    {
+        *ext = 0;
+    }
+
+    snprintf(manifest_file, max_len, "%s.manifest", base);
 } // Build full path from root_dir and relative path
 void build_full_path(const char *root_dir, const char *relative_path, char *full_path, size_t max_len)
 {
@@ -333,6 +432,51 @@ void build_full_path(const char *root_dir, const char *relative_path, char *full
     full_path[max_len - 1] = 0;
 }
 
+// Decode %XX escapes in a request path in place. Escaped '/' and NUL are left
+// encoded so decoding cannot change how the path splits into names.
+void url_decode_path(char *path)
+{
+    char *out = path;
+    for (const char *p = path; *p; p++)
+    {
+        if (p[0] == '%' && isxdigit((unsigned char)p[1]) && isxdigit((unsigned char)p[2]))
+        {
+            char hex[3] = {p[1], p[2], 0};
+            int c = (int)strtol(hex, NULL, 16);
+            if (c != 0 && c != '/')
+            {
+                *out++ = (char)c;
+                p += 2;
+                continue;
+            }
+        }
+        *out++ = *p;
+    }
+    *out = 0;
+}
+
+// Whether a decoded request path stays inside RootDir: no ".." segments,
+// and on Windows no '\\', which is also a path separator there
+int request_path_is_safe(const char *path)
+{
+    const char *segment = path;
+    for (const char *p = path;; p++)
+    {
+#ifdef _WIN32
+        if (*p == '\\')
+            return 0;
+#endif
+        if (*p == '/' || *p == 0)
+        {
+            if (p - segment == 2 && segment[0] == '.' && segment[1] == '.')
+                return 0;
+            if (*p == 0)
+                return 1;
+            segment = p + 1;
+        }
+    }
+}
+
 // Function to get current GMT date in HTTP  friendly format
 void get_gmt_date(char *date_buffer, size_t max_len)
 {
@@ -344,6 +488,26 @@ void get_gmt_date(char *date_buffer, size_t max_len)
     strftime(date_buffer, max_len, "%a, %d %b %Y %H:%M:%S GMT", timeinfo);
 }
 
+// Monotonic clock in microseconds, for measuring elapsed time
+uint64_t get_monotonic_us(void)
+{
+#ifdef _WIN32
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER now;
+    if (freq.QuadPart == 0)
+    {
+        QueryPerformanceFrequency(&freq);
+    }
+    QueryPerformanceCounter(&now);
+    return (uint64_t)(now.QuadPart / freq.QuadPart) * 1000000 +
+           (uint64_t)(now.QuadPart % freq.QuadPart) * 1000000 / freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+#endif
+}
+
 // Initialize Winsock on Windows
 void init_networking(void)
 {
@@ -405,6 +569,11 @@ void signal_handler(int signal)
         g_run = 0;
         // Don't close socket here - let select() timeout handle it
     }
+    else if (signal == SIGUSR1)
+    {
+        // Toggle tracing, handled by the main loop
+        g_trace_toggle = 1;
+    }
 }
 #endif // Setup signal handlers
 void setup_signal_handlers(void)
@@ -429,6 +598,14 @@ void setup_signal_handlers(void)
     {
         log_message(LOG_WARN, "Failed to set SIGTERM handler");
     }
+
+    // Restart interrupted recv()/send() so toggling tracing can't drop a
+    // request; select() still returns EINTR so the main loop sees the toggle
+    sa.sa_flags = SA_RESTART;
+    if (sigaction(SIGUSR1, &sa, NULL) == -1)
+    {
+        log_message(LOG_WARN, "Failed to set SIGUSR1 handler");
+    }
 #endif
 }
 
@@ -443,6 +620,21 @@ void init_config(Config *config)
     config->exec_start_win[0] = 0;
     config->exec_start_linux[0] = 0;
     config->exec_start_macos[0] = 0;
+    config->manifest_enabled = 0;
+    config->warmup_files = 64;
+    config->manifest_file[0] = 0;
+    config->rate_limit = 0;
+    config->rate_burst = 0;
+    config->rate_limit_allow[0] = 0;
+    config->access_log[0] = 0;
+    config->access_log_records = ACCESS_LOG_DEFAULT_RECORDS;
+    config->auto_sidebar = 0;
+    config->cache_size = 0;
+    config->cache_max_file_size = 1024;
+    config->trace_enabled = 0;
+    config->trace_sample = 100;
+    strncpy(config->trace_file, "showdocs-trace.json", MAX_PATH_LEN - 1);
+    config->trace_file[MAX_PATH_LEN - 1] = 0;
 } // Load configuration from file and command line
 void load_config(Config *config, int argc, char *argv[])
 {
@@ -464,6 +656,9 @@ void load_config(Config *config, int argc, char *argv[])
         log_message(LOG_WARN, "No config file found (%s), using defaults", config_file);
     }
 
+    // Manifest lives next to the config file (showdocs.ini -> showdocs.manifest)
+    get_manifest_filename(config_file, config->manifest_file, sizeof(config->manifest_file));
+
     // Command line arguments override config file
     if (argc > 1)
     {
@@ -479,6 +674,18 @@ void load_config(Config *config, int argc, char *argv[])
         }
     }
 
+    if (config->access_log_records <= 0 || config->access_log_records > ACCESS_LOG_MAX_RECORDS)
+    {
+        log_message(LOG_WARN, "AccessLogRecords must be 1-%d, using %d",
+                    ACCESS_LOG_MAX_RECORDS, ACCESS_LOG_DEFAULT_RECORDS);
+        config->access_log_records = ACCESS_LOG_DEFAULT_RECORDS;
+    }
+
+    if (config->trace_sample <= 0)
+    {
+        config->trace_sample = 1;
+    }
+
     log_message(LOG_INFO, "Using port: %d", config->port);
     if (config->root_dir[0])
     {
@@ -620,164 +827,2791 @@ void execute_startup_command(const char *exec_cmd)
 #endif
 }
 
-// Handle incoming HTTP request
-#ifdef _WIN32
-int handle_request(SOCKET client_sock, Config *config)
+#define FNV_OFFSET_BASIS 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+
+// 64-bit FNV-1a hash, chainable by passing the previous result as hash
+uint64_t fnv1a_update(uint64_t hash, const void *data, size_t len)
 {
-#else
-int handle_request(int client_sock, Config *config)
+    const unsigned char *p = (const unsigned char *)data;
+    for (size_t i = 0; i < len; i++)
+    {
+        hash ^= p[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+// In-memory file cache.
+//
+// Entries are looked up by relative path in a chained hash table and kept
+// on an LRU list within a byte budget. Every lookup stats the file and drops
+// the entry if its size, mtime or inode changed, so edits show up on the
+// next request. Entries are reference counted: an entry evicted while a
+// response is still being sent from it is freed when the last user
+// releases it.
+#define CACHE_BUCKETS 4096 // must be a power of two
+
+typedef struct CacheEntry
 {
-#endif
-    char request[BUFFER_SIZE];
-    memset(request, 0, sizeof(request));
+    struct CacheEntry *hash_next;
+    struct CacheEntry *lru_prev;
+    struct CacheEntry *lru_next;
+    char *path;
+    char *data;
+    size_t size;
+    int64_t mtime;
+    uint64_t inode;
+    int refcount;
+    int evicted;
+} CacheEntry;
 
-    ssize_t bytes_received = recv(client_sock, request, sizeof(request) - 1, 0);
-    if (bytes_received <= 0)
-        return 1;
+typedef struct
+{
+    size_t capacity; // byte budget, 0 disables the cache
+    size_t max_file_size;
+    size_t bytes;
+    unsigned long entries;
+    unsigned long hits;
+    unsigned long misses; // lookups served from disk, including uncacheable files
+    unsigned long uncacheable;
+    unsigned long stale;
+    unsigned long evictions;
+    CacheEntry *lru_head; // most recently used
+    CacheEntry *lru_tail;
+    CacheEntry *buckets[CACHE_BUCKETS];
+} FileCache;
+
+static FileCache g_cache;
+
+// Set up the cache from config
+void cache_init(FileCache *cache, Config *config)
+{
+    memset(cache, 0, sizeof(*cache));
+    if (config->cache_size <= 0)
+        return;
 
-    strtok(request, " ");
-    char *path = strtok(NULL, " ");
+    cache->capacity = (size_t)config->cache_size * 1024;
+    cache->max_file_size = (size_t)config->cache_max_file_size * 1024;
+    log_message(LOG_INFO, "File cache: %d KB, files up to %d KB",
+                config->cache_size, config->cache_max_file_size);
+}
 
-    // If no path or path is "/", default to index.html
-    if (!path || strcmp(path, "/") == 0)
+// Hash bucket for a relative path
+uint32_t cache_bucket(const char *path)
+{
+    return (uint32_t)fnv1a_update(FNV_OFFSET_BASIS, path, strlen(path)) & (CACHE_BUCKETS - 1);
+}
+
+// Free an entry's memory
+void cache_free_entry(CacheEntry *entry)
+{
+    free(entry->path);
+    free(entry->data);
+    free(entry);
+}
+
+// Unlink an entry from the LRU list
+void cache_lru_unlink(FileCache *cache, CacheEntry *entry)
+{
+    if (entry->lru_prev)
+        entry->lru_prev->lru_next = entry->lru_next;
+    else
+        cache->lru_head = entry->lru_next;
+    if (entry->lru_next)
+        entry->lru_next->lru_prev = entry->lru_prev;
+    else
+        cache->lru_tail = entry->lru_prev;
+    entry->lru_prev = entry->lru_next = NULL;
+}
+
+// Put an entry at the most recently used end of the LRU list
+void cache_lru_push(FileCache *cache, CacheEntry *entry)
+{
+    entry->lru_prev = NULL;
+    entry->lru_next = cache->lru_head;
+    if (cache->lru_head)
+        cache->lru_head->lru_prev = entry;
+    cache->lru_head = entry;
+    if (!cache->lru_tail)
+        cache->lru_tail = entry;
+}
+
+// Remove an entry from the cache, freeing it now or on its last release
+void cache_remove(FileCache *cache, CacheEntry *entry)
+{
+    CacheEntry **link = &cache->buckets[cache_bucket(entry->path)];
+    while (*link && *link != entry)
+        link = &(*link)->hash_next;
+    if (*link)
+        *link = entry->hash_next;
+
+    cache_lru_unlink(cache, entry);
+    cache->bytes -= entry->size;
+    cache->entries--;
+    entry->evicted = 1;
+    if (entry->refcount == 0)
+        cache_free_entry(entry);
+}
+
+// Evict least recently used entries until the cache fits its budget
+void cache_evict(FileCache *cache)
+{
+    CacheEntry *entry = cache->lru_tail;
+    while (entry && cache->bytes > cache->capacity)
     {
-        path = "index.html";
+        CacheEntry *prev = entry->lru_prev;
+        cache_remove(cache, entry);
+        cache->evictions++;
+        entry = prev;
     }
-    else if (path[0] == '/')
+}
+
+// Read a whole file into a new entry, NULL if it can't be read
+CacheEntry *cache_load(const char *full_path, const char *path, const struct stat *st)
+{
+    CacheEntry *entry = calloc(1, sizeof(CacheEntry));
+    if (!entry)
+        return NULL;
+
+    entry->size = (size_t)st->st_size;
+    entry->mtime = (int64_t)st->st_mtime;
+    entry->inode = (uint64_t)st->st_ino;
+    entry->path = malloc(strlen(path) + 1);
+    entry->data = malloc(entry->size ? entry->size : 1);
+
+    FILE *fp = fopen(full_path, "rb");
+    int ok = entry->path && entry->data && fp &&
+             fread(entry->data, 1, entry->size, fp) == entry->size;
+    if (fp)
+        fclose(fp);
+    if (!ok)
     {
-        path++; // Remove leading '/'
+        cache_free_entry(entry);
+        return NULL;
     }
 
-    log_message(LOG_INFO, "Request: %s", path);
+    strcpy(entry->path, path);
+    return entry;
+}
 
-    char date_buffer[128];
-    get_gmt_date(date_buffer, sizeof(date_buffer));
+// Get a referenced entry for a file, loading it on a miss.
+// Returns NULL if the cache is disabled, the file is missing or too large.
+CacheEntry *cache_acquire(FileCache *cache, const char *root_dir, const char *path)
+{
+    if (cache->capacity == 0)
+        return NULL;
 
-    // Serve requested file or 404
     char full_path[MAX_PATH_LEN];
-    build_full_path(config->root_dir, path, full_path, sizeof(full_path));
-    FILE *fp = fopen(full_path, "rb");
-    if (fp)
+    build_full_path(root_dir, path, full_path, sizeof(full_path));
+
+    CacheEntry *entry = cache->buckets[cache_bucket(path)];
+    while (entry && strcmp(entry->path, path) != 0)
+        entry = entry->hash_next;
+
+    struct stat st;
+    if (stat(full_path, &st) != 0 || !S_ISREG(st.st_mode))
     {
-        fclose(fp);
-        send_http_response(client_sock, "HTTP/1.1 200 OK", path, date_buffer, config->root_dir);
-        log_message(LOG_INFO, "200 OK: %s", path);
+        if (entry)
+            cache_remove(cache, entry);
+        return NULL;
     }
-    else
+
+    if (entry)
     {
-        char full_404_path[MAX_PATH_LEN];
-        build_full_path(config->root_dir, "404.html", full_404_path, sizeof(full_404_path));
-        FILE *fp404 = fopen(full_404_path, "rb");
-        if (fp404)
+        if (entry->size == (size_t)st.st_size && entry->mtime == (int64_t)st.st_mtime &&
+            entry->inode == (uint64_t)st.st_ino)
         {
-            fclose(fp404);
-            send_http_response(client_sock, "HTTP/1.1 404 Not Found", "404.html", date_buffer, config->root_dir);
-            log_message(LOG_WARN, "404 Not Found: %s", path);
+            cache_lru_unlink(cache, entry);
+            cache_lru_push(cache, entry);
+            entry->refcount++;
+            cache->hits++;
+            return entry;
         }
-        else
+        // Changed on disk since it was cached
+        cache_remove(cache, entry);
+        cache->stale++;
+    }
+
+    cache->misses++;
+    if ((size_t)st.st_size > cache->max_file_size || (size_t)st.st_size > cache->capacity)
+    {
+        cache->uncacheable++;
+        return NULL;
+    }
+
+    entry = cache_load(full_path, path, &st);
+    if (!entry)
+        return NULL;
+
+    uint32_t bucket = cache_bucket(path);
+    entry->hash_next = cache->buckets[bucket];
+    cache->buckets[bucket] = entry;
+    cache_lru_push(cache, entry);
+    entry->refcount = 1;
+    cache->bytes += entry->size;
+    cache->entries++;
+    cache_evict(cache);
+    return entry;
+}
+
+// Drop a reference taken by cache_acquire
+void cache_release(FileCache *cache, CacheEntry *entry)
+{
+    (void)cache;
+    if (entry && --entry->refcount == 0 && entry->evicted)
+        cache_free_entry(entry);
+}
+
+// Free every entry in the cache
+void cache_destroy(FileCache *cache)
+{
+    while (cache->lru_head)
+        cache_remove(cache, cache->lru_head);
+}
+
+// MIME types recorded in the manifest, index 0 is the fallback
+typedef struct
+{
+    const char *ext;
+    const char *type;
+} MimeType;
+
+static const MimeType g_mime_types[] = {
+    {"", "application/octet-stream"},
+    {".html", "text/html"},
+    {".htm", "text/html"},
+    {".md", "text/markdown"},
+    {".css", "text/css"},
+    {".js", "application/javascript"},
+    {".mjs", "application/javascript"},
+    {".json", "application/json"},
+    {".txt", "text/plain"},
+    {".svg", "image/svg+xml"},
+    {".png", "image/png"},
+    {".jpg", "image/jpeg"},
+    {".jpeg", "image/jpeg"},
+    {".gif", "image/gif"},
+    {".ico", "image/x-icon"},
+};
+
+#define MIME_TYPE_COUNT (sizeof(g_mime_types) / sizeof(g_mime_types[0]))
+
+// Look up the MIME table index for a path from its extension
+uint8_t get_mime_index(const char *path)
+{
+    const char *ext = strrchr(path, '.');
+    if (ext && !strchr(ext, '/'))
+    {
+        for (size_t i = 1; i < MIME_TYPE_COUNT; i++)
         {
-            log_message(LOG_ERROR, "404 page not found and no 404.html available");
+            if (strcasecmp(ext, g_mime_types[i].ext) == 0)
+                return (uint8_t)i;
         }
     }
-
-    return 1; // Continue running
+    return 0;
 }
 
-// Sends the file contents plus a built HTTP header for status_line
-void send_http_response(int client_sock,
-                        const char *status_line,
-                        const char *filename,
-                        const char *date_str,
-                        const char *root_dir)
+// Get the MIME type string for a MIME table index
+const char *get_mime_type(uint8_t index)
 {
-    // Build full path with root directory
-    char full_path[MAX_PATH_LEN];
-    build_full_path(root_dir, filename, full_path, sizeof(full_path));
+    if (index >= MIME_TYPE_COUNT)
+        index = 0;
+    return g_mime_types[index].type;
+}
 
-    // Attempt to open the file
+#define MARKDOWN_TITLE_LEN 128
+
+// Find the first heading in a markdown file, returns 0 if there is none
+int read_markdown_title(const char *full_path, char *title, size_t max_len)
+{
     FILE *fp = fopen(full_path, "rb");
     if (!fp)
+        return 0;
+
+    char line[512];
+    int in_code = 0;
+    int found = 0;
+    for (int n = 0; n < 64 && fgets(line, sizeof(line), fp); n++)
     {
-        // If file can't be opened, return
-        return;
-    }
+        if (strncmp(line, "```", 3) == 0)
+        {
+            in_code = !in_code;
+            continue;
+        }
+        if (in_code || line[0] != '#')
+            continue;
 
-    // Finds file size
-    fseek(fp, 0, SEEK_END);
-    long file_size = ftell(fp);
-    rewind(fp);
+        char *start = line;
+        while (*start == '#')
+            start++;
+        if (!isspace((unsigned char)*start))
+            continue;
 
-    // Builds header string
-    char header[512];
-    snprintf(header, sizeof(header),
-             "%s\r\n"
-             "Content-Type: text/html\r\n"
-             "Date: %s\r\n"
-             "Content-Length: %ld\r\n"
-             "\r\n",
-             status_line, date_str, file_size);
+        // Strip surrounding whitespace, closing #'s and link brackets
+        char *dst = title;
+        for (char *p = start; *p && (size_t)(dst - title) < max_len - 1; p++)
+        {
+            if (*p != '[' && *p != ']' && *p != '\r' && *p != '\n')
+                *dst++ = *p;
+        }
+        *dst = 0;
+        while (dst > title && (isspace((unsigned char)dst[-1]) || dst[-1] == '#'))
+            *--dst = 0;
+        char *first = title;
+        while (isspace((unsigned char)*first))
+            first++;
+        memmove(title, first, strlen(first) + 1);
+        found = title[0] != 0;
+        break;
+    }
 
-    // Sends header
-    send(client_sock, header, strlen(header), 0);
+    fclose(fp);
+    return found;
+}
 
-    // Sendsfile contents
-    char file_buffer[BUFFER_SIZE];
+// Hash the contents of a file, returns 0 if it can't be read
+int hash_file(const char *full_path, uint64_t *hash_out)
+{
+    FILE *fp = fopen(full_path, "rb");
+    if (!fp)
+        return 0;
 
+    char buffer[BUFFER_SIZE];
+    uint64_t hash = FNV_OFFSET_BASIS;
     size_t bytes_read;
-    while ((bytes_read = fread(file_buffer, 1, sizeof(file_buffer), fp)) > 0)
+    while ((bytes_read = fread(buffer, 1, sizeof(buffer), fp)) > 0)
     {
-        send(client_sock, file_buffer, bytes_read, 0);
+        hash = fnv1a_update(hash, buffer, bytes_read);
     }
 
     fclose(fp);
+    *hash_out = hash;
+    return 1;
 }
 
-int main(int argc, char *argv[])
+// Metadata manifest of everything under RootDir.
+//
+// Entries are stored exactly as they are written to disk: a header, the entry
+// array and a blob of NUL-terminated relative paths ('/' separated, "" is the
+// root). Each directory's children are contiguous in the entry array, so an
+// unchanged directory can reuse its previous listing without a readdir().
+#define MANIFEST_MAGIC 0x4d434453 // "SDCM"
+#define MANIFEST_VERSION 3
+#define MANIFEST_MAX_DEPTH 32
+#define MANIFEST_MAX_ENTRIES 0x1000000
+
+// manifest_scan() options
+#define MANIFEST_CHECK_FILES 1 // stat files in unchanged directories
+#define MANIFEST_HASH_FILES 2 // hash new and changed files, only needed when saved
+
+typedef struct
 {
-    print_version();
-    init_networking();
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entry_count;
+    uint32_t string_bytes;
+    uint64_t root_hash;
+    uint64_t body_hash;
+    int64_t scan_time;
+} ManifestHeader;
 
-    Config config;
-    init_config(&config);
-    load_config(&config, argc, argv);
+typedef struct
+{
+    uint64_t size;
+    int64_t mtime;
+    uint64_t inode;
+    uint64_t content_hash; // FNV-1a of the file contents, also used as the ETag
+    uint32_t path_off;
+    uint32_t access_count;
+    uint32_t first_child; // directories only
+    uint32_t child_count; // directories only
+    uint32_t title_off; // first markdown heading, UINT32_MAX if none
+    uint8_t is_dir;
+    uint8_t mime;
+    uint8_t reserved[2];
+} ManifestEntry;
 
-    g_server_sock = create_server_socket(&config);
+typedef struct
+{
+    ManifestEntry *entries;
+    uint32_t count;
+    uint32_t capacity;
+    char *strings;
+    uint32_t strings_len;
+    uint32_t strings_cap;
+    uint32_t *index; // open addressing table of entry number + 1, 0 is empty
+    uint32_t index_size;
+    int64_t scan_time; // wall-clock second the scan started
+    int flags; // MANIFEST_* options of the scan that built it, not saved
+} Manifest;
 
-    // Setup signal handlers for graceful shutdown
-    setup_signal_handlers();
+typedef struct
+{
+    unsigned long dirs_listed;
+    unsigned long dirs_reused;
+    unsigned long files_changed;
+    unsigned long files_hashed;
+} ManifestScanStats;
 
-    const char *exec_cmd = get_exec_command(&config);
-    execute_startup_command(exec_cmd);
+static Manifest g_manifest;
 
-    // Main server loop
-    while (g_run)
+// Release all memory held by a manifest
+void manifest_free(Manifest *m)
+{
+    free(m->entries);
+    free(m->strings);
+    free(m->index);
+    memset(m, 0, sizeof(*m));
+}
+
+// Get the relative path of a manifest entry
+const char *manifest_path(const Manifest *m, const ManifestEntry *e)
+{
+    return m->strings + e->path_off;
+}
+
+// Get the title of a manifest entry, "" if it has none
+const char *manifest_title(const Manifest *m, const ManifestEntry *e)
+{
+    return e->title_off == UINT32_MAX ? "" : m->strings + e->title_off;
+}
+
+// Copy a string into the path blob, returns its offset or UINT32_MAX on failure
+uint32_t manifest_add_string(Manifest *m, const char *str)
+{
+    uint32_t len = (uint32_t)strlen(str) + 1;
+    if (m->strings_len + len > m->strings_cap)
     {
-        // Use select() with timeout to allow checking g_run periodically
-        fd_set read_fds;
-        FD_ZERO(&read_fds);
-        FD_SET(g_server_sock, &read_fds);
+        uint32_t new_cap = m->strings_cap ? m->strings_cap : 4096;
+        while (m->strings_len + len > new_cap)
+            new_cap *= 2;
+        char *strings = realloc(m->strings, new_cap);
+        if (!strings)
+            return UINT32_MAX;
+        m->strings = strings;
+        m->strings_cap = new_cap;
+    }
 
-        struct timeval timeout;
-        timeout.tv_sec = 1; // 1 second timeout
-        timeout.tv_usec = 0;
+    uint32_t offset = m->strings_len;
+    memcpy(m->strings + offset, str, len);
+    m->strings_len += len;
+    return offset;
+}
 
-        int select_result = select(g_server_sock + 1, &read_fds, NULL, NULL, &timeout);
+// Append an empty entry for path, returns its index or UINT32_MAX on failure
+uint32_t manifest_add(Manifest *m, const char *path)
+{
+    if (m->count >= MANIFEST_MAX_ENTRIES)
+        return UINT32_MAX;
 
-        if (select_result < 0)
+    if (m->count == m->capacity)
+    {
+        uint32_t new_cap = m->capacity ? m->capacity * 2 : 256;
+        ManifestEntry *entries = realloc(m->entries, new_cap * sizeof(ManifestEntry));
+        if (!entries)
+            return UINT32_MAX;
+        m->entries = entries;
+        m->capacity = new_cap;
+    }
+
+    uint32_t path_off = manifest_add_string(m, path);
+    if (path_off == UINT32_MAX)
+        return UINT32_MAX;
+
+    ManifestEntry *e = &m->entries[m->count];
+    memset(e, 0, sizeof(*e));
+    e->path_off = path_off;
+    e->title_off = UINT32_MAX;
+    return m->count++;
+}
+
+// Build the path lookup table, sized to keep the load factor under 50%
+int manifest_build_index(Manifest *m)
+{
+    uint32_t size = 16;
+    while (size < m->count * 2)
+        size *= 2;
+
+    uint32_t *index = calloc(size, sizeof(uint32_t));
+    if (!index)
+        return 0;
+
+    for (uint32_t i = 0; i < m->count; i++)
+    {
+        const char *path = manifest_path(m, &m->entries[i]);
+        uint32_t slot = (uint32_t)fnv1a_update(FNV_OFFSET_BASIS, path, strlen(path)) & (size - 1);
+        while (index[slot])
+            slot = (slot + 1) & (size - 1);
+        index[slot] = i + 1;
+    }
+
+    free(m->index);
+    m->index = index;
+    m->index_size = size;
+    return 1;
+}
+
+// Find the entry for a relative path, or NULL
+ManifestEntry *manifest_find(const Manifest *m, const char *path)
+{
+    if (!m || !m->index)
+        return NULL;
+
+    uint32_t mask = m->index_size - 1;
+    uint32_t slot = (uint32_t)fnv1a_update(FNV_OFFSET_BASIS, path, strlen(path)) & mask;
+    while (m->index[slot])
+    {
+        ManifestEntry *e = &m->entries[m->index[slot] - 1];
+        if (strcmp(manifest_path(m, e), path) == 0)
+            return e;
+        slot = (slot + 1) & mask;
+    }
+    return NULL;
+}
+
+// Build the on-disk path for a manifest relative path
+void manifest_full_path(const char *root_dir, const char *relative_path, char *full_path, size_t max_len)
+{
+    if (relative_path[0] == 0)
+    {
+        snprintf(full_path, max_len, "%s", root_dir[0] ? root_dir : ".");
+    }
+    else
+    {
+        build_full_path(root_dir, relative_path, full_path, max_len);
+    }
+}
+
+// Hash of the root directory, so a manifest is not reused for another tree
+uint64_t manifest_root_hash(const char *root_dir)
+{
+    return fnv1a_update(FNV_OFFSET_BASIS, root_dir, strlen(root_dir));
+}
+
+// Hash of the entry array and path blob
+uint64_t manifest_body_hash(const Manifest *m)
+{
+    uint64_t hash = fnv1a_update(FNV_OFFSET_BASIS, m->entries, (size_t)m->count * sizeof(ManifestEntry));
+    return fnv1a_update(hash, m->strings, m->strings_len);
+}
+
+// Load and validate a manifest file, returns 0 if missing, stale or corrupt
+int manifest_load(Manifest *m, const char *manifest_file, const char *root_dir)
+{
+    memset(m, 0, sizeof(*m));
+
+    FILE *fp = fopen(manifest_file, "rb");
+    if (!fp)
+        return 0;
+
+    ManifestHeader header;
+    int ok = fread(&header, sizeof(header), 1, fp) == 1 &&
+             header.magic == MANIFEST_MAGIC &&
+             header.version == MANIFEST_VERSION &&
+             header.root_hash == manifest_root_hash(root_dir) &&
+             header.entry_count > 0 && header.entry_count <= MANIFEST_MAX_ENTRIES &&
+             header.string_bytes > 0 && (uint64_t)header.string_bytes <= (uint64_t)header.entry_count * MAX_PATH_LEN;
+
+    if (ok)
+    {
+        m->entries = malloc((size_t)header.entry_count * sizeof(ManifestEntry));
+        m->strings = malloc(header.string_bytes);
+        ok = m->entries && m->strings &&
+             fread(m->entries, sizeof(ManifestEntry), header.entry_count, fp) == header.entry_count &&
+             fread(m->strings, 1, header.string_bytes, fp) == header.string_bytes;
+    }
+    fclose(fp);
+
+    if (ok)
+    {
+        m->count = m->capacity = header.entry_count;
+        m->strings_len = m->strings_cap = header.string_bytes;
+        m->scan_time = header.scan_time;
+        ok = m->strings[m->strings_len - 1] == 0 && manifest_body_hash(m) == header.body_hash;
+    }
+
+    for (uint32_t i = 0; ok && i < m->count; i++)
+    {
+        const ManifestEntry *e = &m->entries[i];
+        ok = e->path_off < m->strings_len && e->mime < MIME_TYPE_COUNT &&
+             (e->title_off == UINT32_MAX || e->title_off < m->strings_len) &&
+             (!e->is_dir || (e->first_child <= m->count && e->child_count <= m->count - e->first_child));
+    }
+
+    if (!ok || !manifest_build_index(m))
+    {
+        manifest_free(m);
+        return 0;
+    }
+    return 1;
+}
+
+// Write the manifest to a temp file and move it into place
+int manifest_save(const Manifest *m, const char *manifest_file, const char *root_dir)
+{
+    char temp_file[MAX_PATH_LEN + 8];
+    snprintf(temp_file, sizeof(temp_file), "%s.tmp", manifest_file);
+
+    FILE *fp = fopen(temp_file, "wb");
+    if (!fp)
+        return 0;
+
+    ManifestHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = MANIFEST_MAGIC;
+    header.version = MANIFEST_VERSION;
+    header.entry_count = m->count;
+    header.string_bytes = m->strings_len;
+    header.root_hash = manifest_root_hash(root_dir);
+    header.body_hash = manifest_body_hash(m);
+    header.scan_time = m->scan_time;
+
+    int ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+             fwrite(m->entries, sizeof(ManifestEntry), m->count, fp) == m->count &&
+             fwrite(m->strings, 1, m->strings_len, fp) == m->strings_len;
+    ok = (fclose(fp) == 0) && ok;
+
+    if (ok)
+    {
+        // rename() does not replace an existing file on Windows
+        remove(manifest_file);
+        ok = rename(temp_file, manifest_file) == 0;
+    }
+    if (!ok)
+    {
+        remove(temp_file);
+    }
+    return ok;
+}
+
+// Whether an old entry still describes the path. Times only have second
+// resolution, so anything modified during the second the old scan started
+// may have changed again after it was recorded.
+int manifest_entry_unchanged(const Manifest *old, const ManifestEntry *prev, const ManifestEntry *e)
+{
+    return prev->mtime == e->mtime && prev->inode == e->inode && prev->mtime < old->scan_time;
+}
+
+// Whether an entry is a markdown file, the only kind with a title
+int manifest_is_markdown(const ManifestEntry *e)
+{
+    return !e->is_dir && strcmp(get_mime_type(e->mime), "text/markdown") == 0;
+}
+
+// Append a copy of an old file entry without checking the file again
+void manifest_copy_entry(Manifest *cur, const Manifest *old, const ManifestEntry *prev)
+{
+    uint32_t idx = manifest_add(cur, manifest_path(old, prev));
+    if (idx == UINT32_MAX)
+        return;
+
+    ManifestEntry *e = &cur->entries[idx];
+    uint32_t path_off = e->path_off;
+    *e = *prev;
+    e->path_off = path_off;
+    e->title_off = UINT32_MAX;
+    if (prev->title_off != UINT32_MAX)
+        cur->entries[idx].title_off = manifest_add_string(cur, manifest_title(old, prev));
+}
+
+// Stat a path and append it to the manifest, reusing the old hash if unchanged
+void manifest_add_child(Manifest *cur, const Manifest *old, const char *root_dir,
+                        const char *relative_path, int flags, ManifestScanStats *stats)
+{
+    char full_path[MAX_PATH_LEN];
+    manifest_full_path(root_dir, relative_path, full_path, sizeof(full_path));
+
+    struct stat st;
+    if (stat(full_path, &st) != 0 || !(S_ISDIR(st.st_mode) || S_ISREG(st.st_mode)))
+        return;
+
+    uint32_t idx = manifest_add(cur, relative_path);
+    if (idx == UINT32_MAX)
+        return;
+
+    ManifestEntry *e = &cur->entries[idx];
+    e->is_dir = S_ISDIR(st.st_mode) ? 1 : 0;
+    e->mtime = (int64_t)st.st_mtime;
+    e->inode = (uint64_t)st.st_ino;
+    if (e->is_dir)
+        return;
+
+    e->size = (uint64_t)st.st_size;
+    e->mime = get_mime_index(relative_path);
+
+    int is_markdown = manifest_is_markdown(e);
+    char title[MARKDOWN_TITLE_LEN];
+    title[0] = 0;
+
+    const ManifestEntry *prev = manifest_find(old, relative_path);
+    if (prev && !prev->is_dir)
+    {
+        e->access_count = prev->access_count;
+        if (prev->size == e->size && manifest_entry_unchanged(old, prev, e))
+        {
+            e->content_hash = prev->content_hash;
+            if (is_markdown && prev->title_off != UINT32_MAX)
+                e->title_off = manifest_add_string(cur, manifest_title(old, prev));
+            return;
+        }
+    }
+
+    stats->files_changed++;
+    if ((flags & MANIFEST_HASH_FILES) && hash_file(full_path, &e->content_hash))
+        stats->files_hashed++;
+
+    if (is_markdown && read_markdown_title(full_path, title, sizeof(title)))
+        cur->entries[idx].title_off = manifest_add_string(cur, title);
+}
+
+// List a directory entry's children and recurse into subdirectories. Without
+// MANIFEST_CHECK_FILES, the files of an unchanged directory are copied from the old
+// manifest instead of being checked with stat(), unless they were modified
+// too close to the old scan to be trusted.
+void manifest_scan_dir(Manifest *cur, const Manifest *old, const char *root_dir,
+                       uint32_t dir_idx, int depth, int flags, ManifestScanStats *stats)
+{
+    char dir_path[MAX_PATH_LEN];
+    strncpy(dir_path, manifest_path(cur, &cur->entries[dir_idx]), MAX_PATH_LEN - 1);
+    dir_path[MAX_PATH_LEN - 1] = 0;
+
+    uint32_t first_child = cur->count;
+    const ManifestEntry *prev = manifest_find(old, dir_path);
+
+    if (prev && prev->is_dir && manifest_entry_unchanged(old, prev, &cur->entries[dir_idx]))
+    {
+        // Directory unchanged since the last run, so its listing is too
+        for (uint32_t i = 0; i < prev->child_count; i++)
+        {
+            const ManifestEntry *child = &old->entries[prev->first_child + i];
+            if (!(flags & MANIFEST_CHECK_FILES) && !child->is_dir && child->mtime < old->scan_time)
+                manifest_copy_entry(cur, old, child);
+            else
+                manifest_add_child(cur, old, root_dir, manifest_path(old, child), flags, stats);
+        }
+        stats->dirs_reused++;
+    }
+    else
+    {
+        char full_path[MAX_PATH_LEN];
+        manifest_full_path(root_dir, dir_path, full_path, sizeof(full_path));
+
+        DIR *dir = opendir(full_path);
+        if (!dir)
+            return;
+
+        struct dirent *de;
+        while ((de = readdir(dir)) != NULL)
+        {
+            // Skip ".", ".." and hidden entries such as .git
+            if (de->d_name[0] == '.')
+                continue;
+
+            // Skip names that would not fit rather than record a truncated path
+            char child_path[MAX_PATH_LEN];
+            size_t dir_len = strlen(dir_path);
+            size_t name_len = strlen(de->d_name);
+            if (dir_len + name_len + 2 > sizeof(child_path))
+                continue;
+            if (dir_len)
+            {
+                memcpy(child_path, dir_path, dir_len);
+                child_path[dir_len++] = '/';
+            }
+            memcpy(child_path + dir_len, de->d_name, name_len + 1);
+            manifest_add_child(cur, old, root_dir, child_path, flags, stats);
+        }
+        closedir(dir);
+        stats->dirs_listed++;
+    }
+
+    cur->entries[dir_idx].first_child = first_child;
+    cur->entries[dir_idx].child_count = cur->count - first_child;
+
+    if (depth >= MANIFEST_MAX_DEPTH)
+        return;
+
+    uint32_t end = cur->count;
+    for (uint32_t i = first_child; i < end; i++)
+    {
+        if (cur->entries[i].is_dir)
+            manifest_scan_dir(cur, old, root_dir, i, depth + 1, flags, stats);
+    }
+}
+
+// Scan RootDir into a new manifest, using old (may be NULL) to skip unchanged work
+int manifest_scan(Manifest *cur, const Manifest *old, const char *root_dir, int flags,
+                  ManifestScanStats *stats)
+{
+    memset(cur, 0, sizeof(*cur));
+    memset(stats, 0, sizeof(*stats));
+    cur->scan_time = (int64_t)time(NULL);
+    cur->flags = flags;
+
+    manifest_add_child(cur, old, root_dir, "", flags, stats);
+    if (cur->count == 0 || !cur->entries[0].is_dir)
+    {
+        manifest_free(cur);
+        return 0;
+    }
+
+    manifest_scan_dir(cur, old, root_dir, 0, 0, flags, stats);
+    return manifest_build_index(cur);
+}
+
+// Count a served file so the hottest files are warmed first on the next start
+void manifest_record_access(Manifest *m, const char *path)
+{
+    ManifestEntry *e = manifest_find(m, path);
+    if (e && !e->is_dir && e->access_count < UINT32_MAX)
+    {
+        e->access_count++;
+    }
+}
+
+// Re-read the title of a served markdown page if the file changed, returns 1
+// if the title is different. Pages edited in place are not seen by
+// manifest_refresh, which only re-lists changed directories.
+int manifest_check_page(Manifest *m, const char *root_dir, const char *path)
+{
+    ManifestEntry *e = manifest_find(m, path);
+    if (!e || !manifest_is_markdown(e))
+        return 0;
+
+    char full_path[MAX_PATH_LEN];
+    manifest_full_path(root_dir, path, full_path, sizeof(full_path));
+    struct stat st;
+    if (stat(full_path, &st) != 0)
+        return 0;
+    if ((uint64_t)st.st_size == e->size && (int64_t)st.st_mtime == e->mtime && (uint64_t)st.st_ino == e->inode)
+        return 0;
+
+    // Keep the old times while the file's mtime is the current second, so a
+    // second write within it is still noticed on the next request
+    if ((int64_t)st.st_mtime < (int64_t)time(NULL))
+    {
+        e->size = (uint64_t)st.st_size;
+        e->mtime = (int64_t)st.st_mtime;
+        e->inode = (uint64_t)st.st_ino;
+    }
+
+    char title[MARKDOWN_TITLE_LEN];
+    if (!read_markdown_title(full_path, title, sizeof(title)))
+        title[0] = 0;
+    if (strcmp(title, manifest_title(m, e)) == 0)
+        return 0;
+
+    uint32_t title_off = title[0] ? manifest_add_string(m, title) : UINT32_MAX;
+    e->title_off = title_off;
+    return 1;
+}
+
+typedef struct
+{
+    uint32_t access_count;
+    uint32_t entry;
+} WarmupItem;
+
+// Sort warmup candidates by descending access count
+int compare_warmup_items(const void *a, const void *b)
+{
+    const WarmupItem *x = (const WarmupItem *)a;
+    const WarmupItem *y = (const WarmupItem *)b;
+    if (x->access_count != y->access_count)
+        return x->access_count > y->access_count ? -1 : 1;
+    return x->entry < y->entry ? -1 : (x->entry > y->entry);
+}
+
+// Read the most requested files so they are in the OS page cache
+void manifest_warmup(const Manifest *m, const char *root_dir, int max_files)
+{
+    if (max_files <= 0 || m->count == 0)
+        return;
+
+    WarmupItem *items = malloc(m->count * sizeof(WarmupItem));
+    if (!items)
+        return;
+
+    uint32_t item_count = 0;
+    for (uint32_t i = 0; i < m->count; i++)
+    {
+        if (!m->entries[i].is_dir && m->entries[i].access_count > 0)
+        {
+            items[item_count].access_count = m->entries[i].access_count;
+            items[item_count].entry = i;
+            item_count++;
+        }
+    }
+    qsort(items, item_count, sizeof(WarmupItem), compare_warmup_items);
+
+    uint64_t start_us = get_monotonic_us();
+    unsigned long warmed = 0;
+    uint64_t warmed_bytes = 0;
+    char buffer[BUFFER_SIZE];
+    for (uint32_t i = 0; i < item_count && warmed < (unsigned long)max_files; i++)
+    {
+        char full_path[MAX_PATH_LEN];
+        manifest_full_path(root_dir, manifest_path(m, &m->entries[items[i].entry]), full_path, sizeof(full_path));
+
+        // Load into the file cache when enabled, else just the OS page cache
+        CacheEntry *entry = cache_acquire(&g_cache, root_dir, manifest_path(m, &m->entries[items[i].entry]));
+        if (entry)
+        {
+            warmed_bytes += entry->size;
+            cache_release(&g_cache, entry);
+            warmed++;
+            continue;
+        }
+
+        FILE *fp = fopen(full_path, "rb");
+        if (!fp)
+            continue;
+        size_t bytes_read;
+        while ((bytes_read = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+        {
+            warmed_bytes += bytes_read;
+        }
+        fclose(fp);
+        warmed++;
+    }
+    free(items);
+
+    if (warmed > 0)
+    {
+        log_message(LOG_INFO, "Warmed %lu files (%lu KB) in %lu ms", warmed,
+                    (unsigned long)(warmed_bytes / 1024),
+                    (unsigned long)((get_monotonic_us() - start_us) / 1000));
+    }
+}
+
+// Load the previous manifest, rescan RootDir, persist the result and warm up
+void manifest_init(Manifest *m, Config *config)
+{
+    uint64_t start_us = get_monotonic_us();
+
+    Manifest old;
+    int have_old = config->manifest_enabled && manifest_load(&old, config->manifest_file, config->root_dir);
+    if (config->manifest_enabled && !have_old)
+    {
+        log_message(LOG_INFO, "No valid manifest at %s, doing a full scan", config->manifest_file);
+    }
+
+    ManifestScanStats stats;
+    // Content hashes are only kept when the manifest is saved, so an
+    // AutoSidebar-only index just needs listings and markdown headings
+    int flags = MANIFEST_CHECK_FILES | (config->manifest_enabled ? MANIFEST_HASH_FILES : 0);
+    int scanned = manifest_scan(m, have_old ? &old : NULL, config->root_dir, flags, &stats);
+    if (have_old)
+    {
+        manifest_free(&old);
+    }
+    if (!scanned)
+    {
+        log_message(LOG_WARN, "Failed to scan root directory for manifest");
+        return;
+    }
+
+    log_message(LOG_INFO, "Manifest: %lu entries, %lu dirs listed, %lu dirs reused, %lu files hashed in %lu ms",
+                (unsigned long)m->count, stats.dirs_listed, stats.dirs_reused, stats.files_hashed,
+                (unsigned long)((get_monotonic_us() - start_us) / 1000));
+
+    // With only AutoSidebar enabled the index is kept in memory
+    if (!config->manifest_enabled)
+        return;
+
+    if (!manifest_save(m, config->manifest_file, config->root_dir))
+    {
+        log_message(LOG_WARN, "Failed to write manifest: %s", config->manifest_file);
+    }
+
+    manifest_warmup(m, config->root_dir, config->warmup_files);
+}
+
+// Check RootDir's directories against the current manifest, re-listing the
+// ones that changed, returns 1 if anything changed
+int manifest_refresh(Manifest *m, const char *root_dir)
+{
+    Manifest next;
+    ManifestScanStats stats;
+    if (!manifest_scan(&next, m, root_dir, m->flags & MANIFEST_HASH_FILES, &stats))
+        return 0;
+
+    int changed = next.count != m->count || stats.dirs_listed > 0 || stats.files_changed > 0;
+    manifest_free(m);
+    *m = next;
+    return changed;
+}
+
+// Format one byte of a JSON string literal, escaping it if needed
+const char *json_escape_char(unsigned char c, char escaped[8])
+{
+    if (c == '"' || c == '\\')
+        snprintf(escaped, 8, "\\%c", c);
+    else if (c < 0x20)
+        snprintf(escaped, 8, "\\u%04x", c);
+    else
+    {
+        escaped[0] = (char)c;
+        escaped[1] = 0;
+    }
+    return escaped;
+}
+
+// Growable string buffer for generated documents
+typedef struct
+{
+    char *data;
+    size_t len;
+    size_t cap;
+    int failed;
+} StrBuf;
+
+// Append formatted text to a string buffer
+void strbuf_printf(StrBuf *sb, const char *format, ...)
+{
+    if (sb->failed)
+        return;
+
+    for (;;)
+    {
+        size_t avail = sb->cap - sb->len;
+        va_list args;
+        va_start(args, format);
+        int n = avail ? vsnprintf(sb->data + sb->len, avail, format, args) : -1;
+        va_end(args);
+
+        if (n >= 0 && (size_t)n < avail)
+        {
+            sb->len += (size_t)n;
+            return;
+        }
+
+        size_t new_cap = sb->cap ? sb->cap * 2 : 4096;
+        while (n >= 0 && new_cap - sb->len <= (size_t)n)
+            new_cap *= 2;
+        char *data = realloc(sb->data, new_cap);
+        if (!data)
+        {
+            sb->failed = 1;
+            return;
+        }
+        sb->data = data;
+        sb->cap = new_cap;
+    }
+}
+
+// Append a string as a JSON string literal
+void strbuf_json_string(StrBuf *sb, const char *str)
+{
+    char escaped[8];
+    strbuf_printf(sb, "\"");
+    for (const unsigned char *p = (const unsigned char *)str; *p; p++)
+    {
+        strbuf_printf(sb, "%s", json_escape_char(*p, escaped));
+    }
+    strbuf_printf(sb, "\"");
+}
+
+// Append the first len bytes of a path, percent-encoding everything but
+// unreserved characters and '/' so it can be used as a markdown link target
+void strbuf_url_path(StrBuf *sb, const char *path, size_t len)
+{
+    for (const unsigned char *p = (const unsigned char *)path; p < (const unsigned char *)path + len; p++)
+    {
+        if (isalnum(*p) || *p == '-' || *p == '.' || *p == '_' || *p == '~' || *p == '/')
+            strbuf_printf(sb, "%c", *p);
+        else
+            strbuf_printf(sb, "%%%02X", *p);
+    }
+}
+
+// Generated _sidebar.md and site map, rebuilt from the manifest when it changes.
+//
+// Requests only ever read the prebuilt documents. The main loop rescans the
+// manifest between requests, every SITE_INDEX_CHECK_US while idle and every
+// SITE_INDEX_BUSY_CHECK_US when select() never times out. A rescan stats
+// every directory but only lists those whose mtime changed, which is what
+// adding, removing or renaming a file does. Titles are re-read for pages in
+// re-listed directories and for pages that are served.
+#define SITE_INDEX_CHECK_US 2000000
+#define SITE_INDEX_BUSY_CHECK_US 10000000
+
+typedef struct
+{
+    StrBuf sidebar;
+    StrBuf sitemap;
+    uint64_t last_check_us;
+    int valid;
+    int dirty; // a served page's title changed
+} SiteIndex;
+
+static SiteIndex g_site_index;
+
+typedef struct
+{
+    const char *path;
+    uint32_t entry;
+} SiteChild;
+
+// Sort directory children by path
+int compare_site_children(const void *a, const void *b)
+{
+    return strcmp(((const SiteChild *)a)->path, ((const SiteChild *)b)->path);
+}
+
+// Name of an entry without its directory
+const char *site_basename(const char *path)
+{
+    const char *slash = strrchr(path, '/');
+    return slash ? slash + 1 : path;
+}
+
+// Whether an entry is a markdown page that belongs in the sidebar
+int site_is_page(const Manifest *m, const ManifestEntry *e)
+{
+    // Names starting with '_' are docsify's own files (_sidebar.md, _navbar.md)
+    return manifest_is_markdown(e) && site_basename(manifest_path(m, e))[0] != '_';
+}
+
+// Whether a directory contains any pages, directly or below
+int site_dir_has_pages(const Manifest *m, uint32_t dir_idx)
+{
+    const ManifestEntry *dir = &m->entries[dir_idx];
+    for (uint32_t i = 0; i < dir->child_count; i++)
+    {
+        uint32_t child = dir->first_child + i;
+        if (m->entries[child].is_dir ? site_dir_has_pages(m, child) : site_is_page(m, &m->entries[child]))
+            return 1;
+    }
+    return 0;
+}
+
+// Find a directory's README.md entry
+const ManifestEntry *site_dir_readme(const Manifest *m, uint32_t dir_idx)
+{
+    const ManifestEntry *dir = &m->entries[dir_idx];
+    for (uint32_t i = 0; i < dir->child_count; i++)
+    {
+        const ManifestEntry *child = &m->entries[dir->first_child + i];
+        if (!child->is_dir && strcasecmp(site_basename(manifest_path(m, child)), "README.md") == 0)
+            return child;
+    }
+    return NULL;
+}
+
+// Append a sidebar list item, linking to the page without its .md extension
+void site_sidebar_item(StrBuf *sb, const Manifest *m, const ManifestEntry *e, int depth)
+{
+    const char *path = manifest_path(m, e);
+    const char *title = manifest_title(m, e);
+    const char *name = site_basename(path);
+    size_t path_len = strlen(path);
+    size_t name_len = strlen(name);
+
+    if (strcasecmp(name, "README.md") == 0)
+    {
+        // Directory index pages are linked by their directory
+        size_t dir_len = path_len - name_len;
+        if (dir_len == 0)
+        {
+            strbuf_printf(sb, "%*s* [Home](/)\n", depth * 2, "");
+            return;
+        }
+
+        // Fall back to the directory's own name
+        size_t dir_start = dir_len - 1;
+        while (dir_start > 0 && path[dir_start - 1] != '/')
+            dir_start--;
+        strbuf_printf(sb, "%*s* [", depth * 2, "");
+        if (title[0])
+            strbuf_printf(sb, "%s", title);
+        else
+            strbuf_printf(sb, "%.*s", (int)(dir_len - 1 - dir_start), path + dir_start);
+        strbuf_printf(sb, "](");
+        strbuf_url_path(sb, path, dir_len);
+        strbuf_printf(sb, ")\n");
+        return;
+    }
+
+    strbuf_printf(sb, "%*s* [", depth * 2, "");
+    if (title[0])
+        strbuf_printf(sb, "%s", title);
+    else
+        strbuf_printf(sb, "%.*s", (int)(name_len - 3), name);
+    strbuf_printf(sb, "](");
+    strbuf_url_path(sb, path, path_len - 3);
+    strbuf_printf(sb, ")\n");
+}
+
+// Append the sidebar entries for a directory's pages and subdirectories
+void site_sidebar_dir(StrBuf *sb, const Manifest *m, uint32_t dir_idx, int depth)
+{
+    const ManifestEntry *dir = &m->entries[dir_idx];
+    if (dir->child_count == 0)
+        return;
+
+    SiteChild *children = malloc(dir->child_count * sizeof(SiteChild));
+    if (!children)
+    {
+        sb->failed = 1;
+        return;
+    }
+    for (uint32_t i = 0; i < dir->child_count; i++)
+    {
+        children[i].entry = dir->first_child + i;
+        children[i].path = manifest_path(m, &m->entries[children[i].entry]);
+    }
+    qsort(children, dir->child_count, sizeof(SiteChild), compare_site_children);
+
+    // Pages first, the directory's README.md is already its heading
+    for (uint32_t i = 0; i < dir->child_count; i++)
+    {
+        const ManifestEntry *e = &m->entries[children[i].entry];
+        if (site_is_page(m, e) && strcasecmp(site_basename(children[i].path), "README.md") != 0)
+            site_sidebar_item(sb, m, e, depth);
+    }
+
+    for (uint32_t i = 0; i < dir->child_count; i++)
+    {
+        uint32_t child = children[i].entry;
+        if (!m->entries[child].is_dir || !site_dir_has_pages(m, child))
+            continue;
+
+        const ManifestEntry *readme = site_dir_readme(m, child);
+        if (readme)
+            site_sidebar_item(sb, m, readme, depth);
+        else
+            strbuf_printf(sb, "%*s* %s\n", depth * 2, "", site_basename(children[i].path));
+        site_sidebar_dir(sb, m, child, depth + 1);
+    }
+
+    free(children);
+}
+
+// Rebuild the generated documents from the manifest
+void site_index_build(SiteIndex *site, const Manifest *m)
+{
+    site->sidebar.len = 0;
+    site->sidebar.failed = 0;
+    site->sitemap.len = 0;
+    site->sitemap.failed = 0;
+
+    strbuf_printf(&site->sidebar, "<!-- Generated by showdocs -->\n\n");
+    const ManifestEntry *readme = site_dir_readme(m, 0);
+    if (readme)
+        site_sidebar_item(&site->sidebar, m, readme, 0);
+    site_sidebar_dir(&site->sidebar, m, 0, 0);
+
+    StrBuf *sb = &site->sitemap;
+    strbuf_printf(sb, "{\"files\":[");
+    int first = 1;
+    for (uint32_t i = 0; i < m->count; i++)
+    {
+        const ManifestEntry *e = &m->entries[i];
+        if (e->is_dir)
+            continue;
+        strbuf_printf(sb, "%s\n{\"path\":", first ? "" : ",");
+        strbuf_json_string(sb, manifest_path(m, e));
+        strbuf_printf(sb, ",\"title\":");
+        strbuf_json_string(sb, manifest_title(m, e));
+        strbuf_printf(sb, ",\"type\":\"%s\"}", get_mime_type(e->mime));
+        first = 0;
+    }
+    strbuf_printf(sb, "\n]}\n");
+
+    site->valid = !site->sidebar.failed && !site->sitemap.failed;
+}
+
+// Bring the generated documents up to date, rescanning at most once per interval
+void site_index_update(SiteIndex *site, Manifest *m, const char *root_dir, uint64_t interval_us)
+{
+    int changed = 0;
+    uint64_t now = get_monotonic_us();
+    if (now - site->last_check_us >= interval_us)
+    {
+        site->last_check_us = now;
+        changed = manifest_refresh(m, root_dir);
+    }
+
+    if (changed || site->dirty || !site->valid)
+    {
+        if (changed)
+            log_message(LOG_INFO, "RootDir changed, regenerating sidebar and site map");
+        site->dirty = 0;
+        site_index_build(site, m);
+    }
+}
+
+// Free the generated documents
+void site_index_free(SiteIndex *site)
+{
+    free(site->sidebar.data);
+    free(site->sitemap.data);
+    memset(site, 0, sizeof(*site));
+}
+
+// Per-client token bucket rate limiting.
+//
+// Buckets live in a fixed-size open addressing table keyed by IPv4 address,
+// so memory stays bounded however many clients connect. Tokens are kept in
+// millionths so refills need only integer math. A bucket that has been idle
+// long enough to refill completely holds no state worth keeping, so its slot
+// is reused lazily instead of being expired by a sweep.
+#define RATE_TABLE_SIZE 4096 // must be a power of two
+#define RATE_MAX_PROBE 8
+#define RATE_MAX_ALLOW 16
+#define RATE_TOKEN_SCALE 1000000ULL
+
+typedef struct
+{
+    uint32_t addr;
+    uint32_t in_use;
+    uint64_t tokens; // in millionths of a token
+    uint64_t last_us;
+} RateBucket;
+
+typedef struct
+{
+    uint32_t addr;
+    uint32_t mask;
+} RateAllowEntry;
+
+typedef struct
+{
+    uint64_t rate;  // tokens per second, 0 disables limiting
+    uint64_t burst; // bucket capacity
+    RateAllowEntry allow[RATE_MAX_ALLOW];
+    int allow_count;
+    unsigned long rejected;
+    RateBucket buckets[RATE_TABLE_SIZE];
+} RateLimiter;
+
+static RateLimiter g_rate_limiter;
+
+// Parse a comma separated list of IPv4 addresses or CIDR ranges
+void rate_limit_parse_allowlist(RateLimiter *rl, const char *list)
+{
+    char buffer[MAX_CMD_LEN];
+    strncpy(buffer, list, MAX_CMD_LEN - 1);
+    buffer[MAX_CMD_LEN - 1] = 0;
+
+    for (char *item = strtok(buffer, ", "); item; item = strtok(NULL, ", "))
+    {
+        if (rl->allow_count >= RATE_MAX_ALLOW)
+        {
+            log_message(LOG_WARN, "Too many RateLimitAllow entries, ignoring: %s", item);
+            continue;
+        }
+
+        // The prefix must be all digits, "10.0.0.0/" or "/abc" would
+        // otherwise read as /0 and allow every client
+        long prefix = 32;
+        int valid = 1;
+        char *slash = strchr(item, '/');
+        if (slash)
+        {
+            char *end;
+            *slash = 0;
+            valid = isdigit((unsigned char)slash[1]) != 0;
+            prefix = strtol(slash + 1, &end, 10);
+            valid = valid && *end == 0 && prefix <= 32;
+        }
+
+        struct in_addr addr;
+        if (!valid || inet_pton(AF_INET, item, &addr) <= 0)
+        {
+            if (slash)
+                *slash = '/';
+            log_message(LOG_WARN, "Invalid RateLimitAllow entry: %s", item);
+            continue;
+        }
+
+        RateAllowEntry *entry = &rl->allow[rl->allow_count++];
+        entry->mask = prefix == 0 ? 0 : 0xffffffffu << (32 - prefix);
+        entry->addr = ntohl(addr.s_addr) & entry->mask;
+    }
+}
+
+// Set up the rate limiter from config
+void rate_limit_init(RateLimiter *rl, Config *config)
+{
+    memset(rl, 0, sizeof(*rl));
+    if (config->rate_limit <= 0)
+        return;
+
+    rl->rate = (uint64_t)config->rate_limit;
+    rl->burst = config->rate_burst > 0 ? (uint64_t)config->rate_burst : rl->rate;
+    rate_limit_parse_allowlist(rl, config->rate_limit_allow);
+
+    log_message(LOG_INFO, "Rate limit: %lu requests/sec per client, burst %lu, %d allowlisted",
+                (unsigned long)rl->rate, (unsigned long)rl->burst, rl->allow_count);
+}
+
+// Take a token for a client (IPv4 address in host order).
+// Returns 1 if allowed, otherwise 0 with the seconds until a token is free.
+int rate_limit_allow(RateLimiter *rl, uint32_t addr, int *retry_after)
+{
+    if (rl->rate == 0)
+        return 1;
+
+    for (int i = 0; i < rl->allow_count; i++)
+    {
+        if ((addr & rl->allow[i].mask) == rl->allow[i].addr)
+            return 1;
+    }
+
+    uint64_t now = get_monotonic_us();
+    uint64_t capacity = rl->burst * RATE_TOKEN_SCALE;
+    // Time for an empty bucket to refill completely
+    uint64_t idle_us = (rl->burst * 1000000 + rl->rate - 1) / rl->rate;
+
+    // Knuth multiplicative hash spreads sequential addresses across the table
+    uint32_t slot = (addr * 2654435761u) & (RATE_TABLE_SIZE - 1);
+    RateBucket *bucket = NULL;
+    RateBucket *reusable = NULL;
+    RateBucket *oldest = NULL;
+    for (int probe = 0; probe < RATE_MAX_PROBE; probe++)
+    {
+        RateBucket *b = &rl->buckets[(slot + probe) & (RATE_TABLE_SIZE - 1)];
+        if (b->in_use && b->addr == addr)
+        {
+            bucket = b;
+            break;
+        }
+        if (!reusable && (!b->in_use || now - b->last_us >= idle_us))
+            reusable = b;
+        if (!oldest || b->last_us < oldest->last_us)
+            oldest = b;
+    }
+
+    if (!bucket)
+    {
+        // New client: take a free or refilled slot, else evict the least recent
+        bucket = reusable ? reusable : oldest;
+        bucket->addr = addr;
+        bucket->in_use = 1;
+        bucket->tokens = capacity;
+        bucket->last_us = now;
+    }
+    else
+    {
+        uint64_t refill = (now - bucket->last_us) * rl->rate;
+        bucket->tokens = (capacity - bucket->tokens <= refill) ? capacity : bucket->tokens + refill;
+        bucket->last_us = now;
+    }
+
+    if (bucket->tokens >= RATE_TOKEN_SCALE)
+    {
+        bucket->tokens -= RATE_TOKEN_SCALE;
+        return 1;
+    }
+
+    uint64_t missing = RATE_TOKEN_SCALE - bucket->tokens;
+    *retry_after = (int)((missing + rl->rate * RATE_TOKEN_SCALE - 1) / (rl->rate * RATE_TOKEN_SCALE));
+    rl->rejected++;
+    return 0;
+}
+
+// Reply 429 to a client that is over its rate limit
+#ifdef _WIN32
+void send_rate_limited_response(SOCKET client_sock, int retry_after)
+{
+#else
+void send_rate_limited_response(int client_sock, int retry_after)
+{
+#endif
+    // Read the request first, closing with unread data would reset the connection
+    char request[BUFFER_SIZE];
+    recv(client_sock, request, sizeof(request), 0);
+
+    char date_buffer[128];
+    get_gmt_date(date_buffer, sizeof(date_buffer));
+
+    const char *body = "429 Too Many Requests\n";
+    char response[512];
+    snprintf(response, sizeof(response),
+             "HTTP/1.1 429 Too Many Requests\r\n"
+             "Content-Type: text/plain\r\n"
+             "Date: %s\r\n"
+             "Retry-After: %d\r\n"
+             "Content-Length: %lu\r\n"
+             "Connection: close\r\n"
+             "\r\n"
+             "%s",
+             date_buffer, retry_after, (unsigned long)strlen(body), body);
+
+    send(client_sock, response, strlen(response), 0);
+}
+
+// Timing and outcome of a single request, filled in as it is handled
+typedef struct
+{
+    uint32_t client_addr; // IPv4, host order
+    int status;           // 0 if no response was sent
+    uint64_t bytes_sent;
+    char path[MAX_PATH_LEN];
+    uint64_t start_us; // monotonic time the request started
+    uint32_t recv_us;
+    uint32_t open_us;
+    uint32_t send_us;
+} RequestInfo;
+
+// Wall clock in microseconds since the Unix epoch
+uint64_t get_wall_clock_us(void)
+{
+#ifdef _WIN32
+    FILETIME ft;
+    GetSystemTimeAsFileTime(&ft);
+    uint64_t ticks = ((uint64_t)ft.dwHighDateTime << 32) | ft.dwLowDateTime;
+    return ticks / 10 - 11644473600000000ULL; // 100ns ticks since 1601
+#else
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (uint64_t)tv.tv_sec * 1000000 + (uint64_t)tv.tv_usec;
+#endif
+}
+
+// Binary access log.
+//
+// A fixed-size header followed by a ring of fixed-size records. Record i is
+// stored at slot i % capacity, so the file never grows past capacity records
+// and the oldest records are overwritten once it wraps. Paths longer than
+// the record's path field are truncated.
+#define ACCESS_LOG_MAGIC 0x4c414453 // "SDAL"
+#define ACCESS_LOG_VERSION 1
+#define ACCESS_LOG_PATH_LEN 88
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t reserved;
+    uint64_t capacity; // number of record slots
+    uint64_t next;     // total records ever written
+} AccessLogHeader;
+
+typedef struct
+{
+    uint64_t timestamp_us; // wall clock at accept
+    uint64_t bytes;
+    uint32_t client_addr;
+    uint16_t status;
+    uint16_t path_len;
+    uint32_t recv_us;
+    uint32_t open_us;
+    uint32_t send_us;
+    uint32_t total_us;
+    char path[ACCESS_LOG_PATH_LEN];
+} AccessRecord;
+
+// Records go through stdio's buffer; the header's record count is written
+// every ACCESS_LOG_SYNC_RECORDS records, when the server is idle and on close
+#define ACCESS_LOG_SYNC_RECORDS 1024
+
+typedef struct
+{
+    FILE *fp;
+    AccessLogHeader header;
+    uint64_t synced;  // header.next as last written to disk
+    int need_seek;    // file position is not at the next record
+} AccessLog;
+
+static AccessLog g_access_log;
+
+// Open an access log, resuming it if the existing layout matches
+int access_log_open(AccessLog *log, const char *filename, uint64_t capacity)
+{
+    memset(log, 0, sizeof(*log));
+
+    log->fp = fopen(filename, "r+b");
+    if (log->fp)
+    {
+        if (fread(&log->header, sizeof(log->header), 1, log->fp) == 1 &&
+            log->header.magic == ACCESS_LOG_MAGIC &&
+            log->header.version == ACCESS_LOG_VERSION &&
+            log->header.record_size == sizeof(AccessRecord) &&
+            log->header.capacity == capacity)
+        {
+            log->synced = log->header.next;
+            log->need_seek = 1;
+            return 1;
+        }
+        fclose(log->fp);
+    }
+
+    // Missing, corrupt or resized: start a new ring
+    log->fp = fopen(filename, "w+b");
+    if (!log->fp)
+        return 0;
+
+    memset(&log->header, 0, sizeof(log->header));
+    log->header.magic = ACCESS_LOG_MAGIC;
+    log->header.version = ACCESS_LOG_VERSION;
+    log->header.record_size = sizeof(AccessRecord);
+    log->header.capacity = capacity;
+    if (fwrite(&log->header, sizeof(log->header), 1, log->fp) != 1 || fflush(log->fp) != 0)
+    {
+        fclose(log->fp);
+        log->fp = NULL;
+        return 0;
+    }
+    log->need_seek = 1;
+    return 1;
+}
+
+// Write the record count to the header, after the records it counts
+void access_log_sync(AccessLog *log)
+{
+    if (!log->fp || log->synced == log->header.next)
+        return;
+
+    // Flush the records before the header so a crash never counts a missing record
+    if (fflush(log->fp) != 0 ||
+        fseek(log->fp, 0, SEEK_SET) != 0 ||
+        fwrite(&log->header, sizeof(log->header), 1, log->fp) != 1 ||
+        fflush(log->fp) != 0)
+    {
+        log_message(LOG_WARN, "Failed to write access log, disabling it");
+        fclose(log->fp);
+        log->fp = NULL;
+        return;
+    }
+    log->synced = log->header.next;
+    log->need_seek = 1;
+}
+
+// Close the access log
+void access_log_close(AccessLog *log)
+{
+    access_log_sync(log);
+    if (log->fp)
+    {
+        fclose(log->fp);
+        log->fp = NULL;
+    }
+}
+
+// Append a record for a finished request
+void access_log_write(AccessLog *log, const RequestInfo *info, uint64_t timestamp_us, uint32_t total_us)
+{
+    if (!log->fp || info->status == 0)
+        return;
+
+    AccessRecord record;
+    memset(&record, 0, sizeof(record));
+    record.timestamp_us = timestamp_us;
+    record.bytes = info->bytes_sent;
+    record.client_addr = info->client_addr;
+    record.status = (uint16_t)info->status;
+    record.recv_us = info->recv_us;
+    record.open_us = info->open_us;
+    record.send_us = info->send_us;
+    record.total_us = total_us;
+    size_t path_len = strlen(info->path);
+    if (path_len > ACCESS_LOG_PATH_LEN - 1)
+        path_len = ACCESS_LOG_PATH_LEN - 1;
+    memcpy(record.path, info->path, path_len);
+    record.path_len = (uint16_t)path_len;
+
+    // Seek only after a header write or when the ring wraps, since a seek
+    // also flushes stdio's buffer
+    uint64_t slot = log->header.next % log->header.capacity;
+    long offset = (long)(sizeof(AccessLogHeader) + slot * sizeof(AccessRecord));
+    if ((log->need_seek || slot == 0) && fseek(log->fp, offset, SEEK_SET) != 0)
+    {
+        log_message(LOG_WARN, "Failed to write access log, disabling it");
+        access_log_close(log);
+        return;
+    }
+    log->need_seek = 0;
+
+    if (fwrite(&record, sizeof(record), 1, log->fp) != 1)
+    {
+        log_message(LOG_WARN, "Failed to write access log, disabling it");
+        access_log_close(log);
+        return;
+    }
+    log->header.next++;
+
+    if (log->header.next - log->synced >= ACCESS_LOG_SYNC_RECORDS)
+        access_log_sync(log);
+}
+
+// Per-request text logging, left out when the access log records requests
+void log_request(LogLevel level, const char *format, ...)
+{
+    if (g_access_log.fp)
+        return;
+
+    va_list args;
+    va_start(args, format);
+    vlog_message(level, format, args);
+    va_end(args);
+}
+
+// Sort helper for latency percentiles
+int compare_uint32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return x < y ? -1 : (x > y);
+}
+
+// Value at percentile pct of a sorted array
+uint32_t percentile(const uint32_t *sorted, uint64_t count, double pct)
+{
+    if (count == 0)
+        return 0;
+    uint64_t idx = (uint64_t)(pct / 100.0 * (double)(count - 1) + 0.5);
+    return sorted[idx];
+}
+
+typedef struct
+{
+    char path[ACCESS_LOG_PATH_LEN];
+    uint64_t count;
+    uint64_t bytes;
+} PathStat;
+
+// Sort path stats by descending request count
+int compare_path_stats(const void *a, const void *b)
+{
+    const PathStat *x = (const PathStat *)a;
+    const PathStat *y = (const PathStat *)b;
+    if (x->count != y->count)
+        return x->count > y->count ? -1 : 1;
+    return strcmp(x->path, y->path);
+}
+
+#define ANALYZE_CHUNK_RECORDS 8192
+#define ANALYZE_TOP_PATHS 20
+
+// Print top paths, status breakdown and latency percentiles for an access log
+int analyze_access_log(const char *filename)
+{
+    FILE *fp = fopen(filename, "rb");
+    if (!fp)
+    {
+        log_message(LOG_ERROR, "Cannot open access log: %s", filename);
+        return EXIT_FAILURE;
+    }
+
+    AccessLogHeader header;
+    if (fread(&header, sizeof(header), 1, fp) != 1 ||
+        header.magic != ACCESS_LOG_MAGIC || header.version != ACCESS_LOG_VERSION ||
+        header.record_size != sizeof(AccessRecord) || header.capacity == 0 ||
+        header.capacity > ACCESS_LOG_MAX_RECORDS)
+    {
+        log_message(LOG_ERROR, "Not a valid access log: %s", filename);
+        fclose(fp);
+        return EXIT_FAILURE;
+    }
+
+    // Never trust the header for more records than the file holds
+    struct stat st;
+    uint64_t stored = 0;
+    if (fstat(fileno(fp), &st) == 0 && (uint64_t)st.st_size > sizeof(header))
+        stored = ((uint64_t)st.st_size - sizeof(header)) / sizeof(AccessRecord);
+    uint64_t total = header.next < header.capacity ? header.next : header.capacity;
+    if (total > stored)
+        total = stored;
+    uint64_t start_us = get_monotonic_us();
+
+    // Per-phase latencies, sorted afterwards for percentiles
+    uint32_t *latency[4];
+    for (int i = 0; i < 4; i++)
+        latency[i] = malloc((total ? total : 1) * sizeof(uint32_t));
+
+    // Open addressing table of distinct paths
+    uint64_t table_size = 1024;
+    uint64_t path_count = 0;
+    PathStat *paths = calloc(table_size, sizeof(PathStat));
+    AccessRecord *chunk = malloc(ANALYZE_CHUNK_RECORDS * sizeof(AccessRecord));
+
+    int failed = !latency[0] || !latency[1] || !latency[2] || !latency[3] || !paths || !chunk;
+    if (failed)
+    {
+        log_message(LOG_ERROR, "Out of memory analyzing %lu records", (unsigned long)total);
+    }
+
+    uint64_t status_counts[6] = {0}; // by hundreds: 1xx..5xx, [0] other
+    uint64_t total_bytes = 0;
+    uint64_t first_ts = UINT64_MAX, last_ts = 0;
+    uint64_t n = 0;
+
+    while (!failed && n < total)
+    {
+        uint64_t want = total - n < ANALYZE_CHUNK_RECORDS ? total - n : ANALYZE_CHUNK_RECORDS;
+        size_t got = fread(chunk, sizeof(AccessRecord), (size_t)want, fp);
+        if (got == 0)
+            break;
+
+        for (size_t i = 0; i < got && !failed; i++)
+        {
+            AccessRecord *r = &chunk[i];
+            r->path[ACCESS_LOG_PATH_LEN - 1] = 0;
+
+            status_counts[(r->status >= 100 && r->status < 600) ? r->status / 100 : 0]++;
+            total_bytes += r->bytes;
+            if (r->timestamp_us < first_ts)
+                first_ts = r->timestamp_us;
+            if (r->timestamp_us > last_ts)
+                last_ts = r->timestamp_us;
+
+            latency[0][n] = r->total_us;
+            latency[1][n] = r->recv_us;
+            latency[2][n] = r->open_us;
+            latency[3][n] = r->send_us;
+            n++;
+
+            // Grow the path table past 50% load
+            if (path_count * 2 >= table_size)
+            {
+                PathStat *grown = calloc(table_size * 2, sizeof(PathStat));
+                if (!grown)
+                {
+                    log_message(LOG_ERROR, "Out of memory after %lu distinct paths", (unsigned long)path_count);
+                    failed = 1;
+                    break;
+                }
+                for (uint64_t j = 0; j < table_size; j++)
+                {
+                    if (paths[j].count == 0)
+                        continue;
+                    uint64_t slot = fnv1a_update(FNV_OFFSET_BASIS, paths[j].path, strlen(paths[j].path)) & (table_size * 2 - 1);
+                    while (grown[slot].count)
+                        slot = (slot + 1) & (table_size * 2 - 1);
+                    grown[slot] = paths[j];
+                }
+                free(paths);
+                paths = grown;
+                table_size *= 2;
+            }
+
+            uint64_t slot = fnv1a_update(FNV_OFFSET_BASIS, r->path, strlen(r->path)) & (table_size - 1);
+            while (paths[slot].count && strcmp(paths[slot].path, r->path) != 0)
+                slot = (slot + 1) & (table_size - 1);
+            if (paths[slot].count == 0)
+            {
+                memcpy(paths[slot].path, r->path, ACCESS_LOG_PATH_LEN);
+                path_count++;
+            }
+            paths[slot].count++;
+            paths[slot].bytes += r->bytes;
+        }
+    }
+    fclose(fp);
+    free(chunk);
+    if (failed)
+    {
+        for (int i = 0; i < 4; i++)
+            free(latency[i]);
+        free(paths);
+        return EXIT_FAILURE;
+    }
+
+    for (int i = 0; i < 4; i++)
+        qsort(latency[i], (size_t)n, sizeof(uint32_t), compare_uint32);
+
+    // Compact the used slots to the front and sort by count
+    uint64_t used = 0;
+    for (uint64_t j = 0; j < table_size; j++)
+    {
+        if (paths[j].count)
+            paths[used++] = paths[j];
+    }
+    qsort(paths, (size_t)used, sizeof(PathStat), compare_path_stats);
+
+    double span_s = (n > 0 && last_ts > first_ts) ? (double)(last_ts - first_ts) / 1e6 : 0.0;
+    printf("Access log: %s\n", filename);
+    printf("Records: %lu (%lu written, ring capacity %lu)\n",
+           (unsigned long)n, (unsigned long)header.next, (unsigned long)header.capacity);
+    printf("Time span: %.1f s", span_s);
+    if (span_s > 0)
+        printf(", %.1f requests/sec", (double)n / span_s);
+    printf("\nBytes sent: %lu KB\n\n", (unsigned long)(total_bytes / 1024));
+
+    printf("Status:\n");
+    const char *status_names[6] = {"other", "1xx", "2xx", "3xx", "4xx", "5xx"};
+    for (int i = 1; i <= 6; i++)
+    {
+        int s = i % 6;
+        if (status_counts[s])
+            printf("  %-6s %10lu  %5.1f%%\n", status_names[s], (unsigned long)status_counts[s],
+                   100.0 * (double)status_counts[s] / (double)n);
+    }
+
+    printf("\nLatency (us):  %8s %8s %8s %8s %8s\n", "p50", "p90", "p99", "p99.9", "max");
+    const char *phase_names[4] = {"total", "recv", "open", "send"};
+    for (int i = 0; i < 4; i++)
+    {
+        printf("  %-11s %8lu %8lu %8lu %8lu %8lu\n", phase_names[i],
+               (unsigned long)percentile(latency[i], n, 50),
+               (unsigned long)percentile(latency[i], n, 90),
+               (unsigned long)percentile(latency[i], n, 99),
+               (unsigned long)percentile(latency[i], n, 99.9),
+               (unsigned long)(n ? latency[i][n - 1] : 0));
+        free(latency[i]);
+    }
+
+    printf("\nTop paths (%lu distinct):\n", (unsigned long)used);
+    for (uint64_t j = 0; j < used && j < ANALYZE_TOP_PATHS; j++)
+    {
+        printf("  %10lu %10lu KB  %s\n", (unsigned long)paths[j].count,
+               (unsigned long)(paths[j].bytes / 1024), paths[j].path);
+    }
+    free(paths);
+
+    printf("\nAnalyzed in %lu ms\n", (unsigned long)((get_monotonic_us() - start_us) / 1000));
+    return EXIT_SUCCESS;
+}
+
+// Per-request phase tracing.
+//
+// When enabled, 1 in TraceSample requests records a span for each phase of
+// its handling into a fixed ring of events. Requests that are not sampled
+// only pay for a branch. The ring is written as Chrome trace-event JSON,
+// which opens in Perfetto (ui.perfetto.dev) or chrome://tracing.
+#define TRACE_MAX_EVENTS 65536
+#define TRACE_PATH_LEN 44
+
+typedef enum
+{
+    TRACE_REQUEST,
+    TRACE_ACCEPT,
+    TRACE_RATE_LIMIT,
+    TRACE_RECV,
+    TRACE_PARSE,
+    TRACE_OPEN,
+    TRACE_SEND_OPEN,
+    TRACE_SEND_HEADER,
+    TRACE_SEND_BODY,
+    TRACE_CLOSE,
+    TRACE_PHASE_COUNT
+} TracePhase;
+
+static const char *g_trace_phase_names[TRACE_PHASE_COUNT] = {
+    "request", "accept", "rate_limit", "recv", "parse",
+    "open", "send_open", "send_header", "send_body", "close"};
+
+typedef struct
+{
+    uint64_t ts_us;
+    uint32_t dur_us;
+    uint32_t request;
+    uint16_t phase;
+    uint16_t status;            // request spans only
+    char path[TRACE_PATH_LEN]; // request spans only
+} TraceEvent;
+
+typedef struct
+{
+    int enabled;
+    int sample;
+    uint32_t requests; // requests seen while enabled
+    uint32_t current;  // request being traced, 0 if not sampled
+    uint64_t origin_us;
+    TraceEvent *events;
+    uint64_t count; // total events recorded
+} Tracer;
+
+static Tracer g_tracer;
+
+// Current time if the request is being traced, else 0 without reading the clock
+uint64_t trace_now(const Tracer *t)
+{
+    return t->current ? get_monotonic_us() : 0;
+}
+
+// Record a span for the traced request from start_us until now
+TraceEvent *trace_phase(Tracer *t, TracePhase phase, uint64_t start_us)
+{
+    if (!t->current)
+        return NULL;
+
+    uint64_t now = get_monotonic_us();
+    TraceEvent *e = &t->events[t->count % TRACE_MAX_EVENTS];
+    t->count++;
+    memset(e, 0, sizeof(*e));
+    e->ts_us = start_us - t->origin_us;
+    e->dur_us = (uint32_t)(now - start_us);
+    e->request = t->current;
+    e->phase = (uint16_t)phase;
+    return e;
+}
+
+// Decide whether the next request is sampled
+void trace_start_request(Tracer *t)
+{
+    t->current = 0;
+    if (!t->enabled)
+        return;
+
+    t->requests++;
+    if (t->requests % (uint32_t)t->sample == 0)
+    {
+        t->current = t->requests;
+    }
+}
+
+// Record the whole-request span with its path and status, and stop tracing it
+void trace_end_request(Tracer *t, const RequestInfo *info)
+{
+    TraceEvent *e = trace_phase(t, TRACE_REQUEST, info->start_us);
+    if (e)
+    {
+        e->status = (uint16_t)info->status;
+        size_t path_len = strlen(info->path);
+        if (path_len > TRACE_PATH_LEN - 1)
+            path_len = TRACE_PATH_LEN - 1;
+        memcpy(e->path, info->path, path_len);
+        e->path[path_len] = 0;
+    }
+    t->current = 0;
+}
+
+// Write a string as a JSON string literal
+void write_json_string(FILE *fp, const char *str)
+{
+    char escaped[8];
+    fputc('"', fp);
+    for (const unsigned char *p = (const unsigned char *)str; *p; p++)
+    {
+        fputs(json_escape_char(*p, escaped), fp);
+    }
+    fputc('"', fp);
+}
+
+// Write the recorded events as Chrome trace-event JSON and clear the ring
+int trace_dump(Tracer *t, const char *filename)
+{
+    if (t->count == 0)
+        return 1;
+
+    FILE *fp = fopen(filename, "w");
+    if (!fp)
+        return 0;
+
+    fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(fp, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"showdocs\"}},\n");
+    fprintf(fp, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"main\"}}");
+
+    uint64_t first = t->count > TRACE_MAX_EVENTS ? t->count - TRACE_MAX_EVENTS : 0;
+    for (uint64_t i = first; i < t->count; i++)
+    {
+        const TraceEvent *e = &t->events[i % TRACE_MAX_EVENTS];
+        fprintf(fp, ",\n{\"name\":\"%s\",\"cat\":\"request\",\"ph\":\"X\",\"ts\":%lu,\"dur\":%lu,"
+                    "\"pid\":1,\"tid\":1,\"args\":{\"request\":%lu",
+                g_trace_phase_names[e->phase], (unsigned long)e->ts_us,
+                (unsigned long)e->dur_us, (unsigned long)e->request);
+        if (e->phase == TRACE_REQUEST)
+        {
+            fprintf(fp, ",\"status\":%d,\"path\":", e->status);
+            write_json_string(fp, e->path);
+        }
+        fprintf(fp, "}}");
+    }
+    fprintf(fp, "\n]}\n");
+
+    int ok = fclose(fp) == 0;
+    if (ok)
+    {
+        log_message(LOG_INFO, "Wrote %lu trace events to %s",
+                    (unsigned long)(t->count - first), filename);
+        t->count = 0;
+    }
+    return ok;
+}
+
+// Turn tracing on or off, writing out the trace when it is turned off
+void trace_set_enabled(Tracer *t, int enabled, const char *filename)
+{
+    if (enabled && !t->events)
+    {
+        t->events = malloc(TRACE_MAX_EVENTS * sizeof(TraceEvent));
+        if (!t->events)
+        {
+            log_message(LOG_WARN, "Failed to allocate trace buffer");
+            return;
+        }
+    }
+
+    if (enabled && !t->enabled)
+    {
+        t->origin_us = get_monotonic_us();
+        t->requests = 0;
+        t->count = 0;
+        log_message(LOG_INFO, "Tracing enabled, sampling 1 in %d requests", t->sample);
+    }
+    else if (!enabled && t->enabled)
+    {
+        log_message(LOG_INFO, "Tracing disabled");
+        if (!trace_dump(t, filename))
+        {
+            log_message(LOG_WARN, "Failed to write trace file: %s", filename);
+        }
+    }
+    t->enabled = enabled;
+    t->current = 0;
+}
+
+// Slab pools and per-request arenas.
+//
+// Connection objects and their I/O buffers come from slab pools: objects are
+// carved out of large malloc'd slabs and recycled through a free list, so
+// steady-state serving does no malloc/free. An idle connection holds only
+// its small Connection object; the I/O buffer, which carries the request
+// bytes and a bump arena for per-request scratch memory (paths, headers,
+// send buffers), is attached while a request is being handled and the arena
+// is reset when the response is done.
+#define SLAB_HEADER_SIZE 16
+#define CONNECTIONS_PER_SLAB 64
+#define IO_BUFFERS_PER_SLAB 4
+#define CONNECTION_POOL_MAX 65536
+#define REQUEST_ARENA_SIZE 16384
+
+typedef struct Slab
+{
+    struct Slab *next;
+} Slab;
+
+typedef struct
+{
+    size_t object_size;
+    size_t per_slab;
+    size_t max_objects; // 0 for no limit
+    void *free_list;    // next pointer stored in the first bytes of each free object
+    Slab *slabs;
+    size_t allocated; // objects carved from slabs
+    size_t in_use;
+    size_t bytes; // total slab memory
+} SlabPool;
+
+struct Arena
+{
+    unsigned char *base;
+    size_t size;
+    size_t used;
+};
+
+typedef struct
+{
+    RequestInfo info;
+    char request[BUFFER_SIZE];
+    Arena arena;
+    unsigned char arena_block[REQUEST_ARENA_SIZE];
+} IoBuffer;
+
+typedef struct
+{
+#ifdef _WIN32
+    SOCKET sock;
+#else
+    int sock;
+#endif
+    uint32_t client_addr; // IPv4, host order
+    IoBuffer *io;         // attached only while a request is in progress
+} Connection;
+
+static SlabPool g_connection_pool;
+static SlabPool g_io_buffer_pool;
+static size_t g_arena_high_water; // most arena memory used by any request
+
+// Set up an empty pool, objects are rounded up to 16 byte alignment
+void pool_init(SlabPool *pool, size_t object_size, size_t per_slab, size_t max_objects)
+{
+    memset(pool, 0, sizeof(*pool));
+    pool->object_size = (object_size + 15) & ~(size_t)15;
+    pool->per_slab = per_slab;
+    pool->max_objects = max_objects;
+}
+
+// Take an object from the pool, adding a slab if none are free
+void *pool_alloc(SlabPool *pool)
+{
+    if (!pool->free_list)
+    {
+        if (pool->max_objects && pool->allocated >= pool->max_objects)
+            return NULL;
+
+        size_t slab_bytes = SLAB_HEADER_SIZE + pool->per_slab * pool->object_size;
+        Slab *slab = malloc(slab_bytes);
+        if (!slab)
+            return NULL;
+        slab->next = pool->slabs;
+        pool->slabs = slab;
+        pool->bytes += slab_bytes;
+        pool->allocated += pool->per_slab;
+
+        unsigned char *objects = (unsigned char *)slab + SLAB_HEADER_SIZE;
+        for (size_t i = pool->per_slab; i > 0; i--)
+        {
+            void *obj = objects + (i - 1) * pool->object_size;
+            *(void **)obj = pool->free_list;
+            pool->free_list = obj;
+        }
+    }
+
+    void *obj = pool->free_list;
+    pool->free_list = *(void **)obj;
+    pool->in_use++;
+    return obj;
+}
+
+// Return an object to its pool
+void pool_free(SlabPool *pool, void *obj)
+{
+    if (!obj)
+        return;
+    *(void **)obj = pool->free_list;
+    pool->free_list = obj;
+    pool->in_use--;
+}
+
+// Release every slab in the pool
+void pool_destroy(SlabPool *pool)
+{
+    while (pool->slabs)
+    {
+        Slab *next = pool->slabs->next;
+        free(pool->slabs);
+        pool->slabs = next;
+    }
+    pool->free_list = NULL;
+    pool->allocated = pool->in_use = pool->bytes = 0;
+}
+
+// Bump allocate from the arena, NULL if it is exhausted
+void *arena_alloc(Arena *arena, size_t size)
+{
+    size_t offset = (arena->used + 15) & ~(size_t)15;
+    if (offset + size > arena->size)
+        return NULL;
+    arena->used = offset + size;
+    return arena->base + offset;
+}
+
+// Free everything allocated from the arena at once
+void arena_reset(Arena *arena)
+{
+    arena->used = 0;
+}
+
+// Set up the connection and I/O buffer pools
+void connection_pools_init(void)
+{
+    pool_init(&g_connection_pool, sizeof(Connection), CONNECTIONS_PER_SLAB, CONNECTION_POOL_MAX);
+    pool_init(&g_io_buffer_pool, sizeof(IoBuffer), IO_BUFFERS_PER_SLAB, CONNECTION_POOL_MAX);
+}
+
+// Free the connection and I/O buffer pools
+void connection_pools_destroy(void)
+{
+    pool_destroy(&g_connection_pool);
+    pool_destroy(&g_io_buffer_pool);
+}
+
+// Allocate a connection for an accepted socket
+#ifdef _WIN32
+Connection *connection_open(SOCKET sock, const struct sockaddr_in *client_addr)
+{
+#else
+Connection *connection_open(int sock, const struct sockaddr_in *client_addr)
+{
+#endif
+    Connection *conn = pool_alloc(&g_connection_pool);
+    if (!conn)
+        return NULL;
+
+    memset(conn, 0, sizeof(*conn));
+    conn->sock = sock;
+    conn->client_addr = ntohl(client_addr->sin_addr.s_addr);
+    return conn;
+}
+
+// Attach an I/O buffer with an empty arena and request info for the next request
+int connection_begin_request(Connection *conn)
+{
+    if (!conn->io)
+    {
+        conn->io = pool_alloc(&g_io_buffer_pool);
+        if (!conn->io)
+            return 0;
+        conn->io->arena.base = conn->io->arena_block;
+        conn->io->arena.size = sizeof(conn->io->arena_block);
+    }
+    arena_reset(&conn->io->arena);
+    memset(&conn->io->info, 0, sizeof(conn->io->info));
+    conn->io->info.start_us = get_monotonic_us();
+    conn->io->info.client_addr = conn->client_addr;
+    return 1;
+}
+
+// Detach the I/O buffer once a response is done, leaving the connection idle
+void connection_end_request(Connection *conn)
+{
+    if (conn->io)
+    {
+        if (conn->io->arena.used > g_arena_high_water)
+            g_arena_high_water = conn->io->arena.used;
+        pool_free(&g_io_buffer_pool, conn->io);
+        conn->io = NULL;
+    }
+}
+
+// Return a connection to the pool, its socket must already be closed
+void connection_free(Connection *conn)
+{
+    connection_end_request(conn);
+    pool_free(&g_connection_pool, conn);
+}
+
+// Format server metrics in the Prometheus text exposition format
+size_t format_metrics(char *buffer, size_t max_len)
+{
+    unsigned long lookups = g_cache.hits + g_cache.misses;
+    int len = snprintf(buffer, max_len,
+                       "showdocs_cache_hits_total %lu\n"
+                       "showdocs_cache_misses_total %lu\n"
+                       "showdocs_cache_uncacheable_total %lu\n"
+                       "showdocs_cache_stale_total %lu\n"
+                       "showdocs_cache_evictions_total %lu\n"
+                       "showdocs_cache_hit_ratio %.4f\n"
+                       "showdocs_cache_entries %lu\n"
+                       "showdocs_cache_bytes %lu\n"
+                       "showdocs_cache_capacity_bytes %lu\n"
+                       "showdocs_rate_limited_total %lu\n"
+                       "showdocs_connections_active %lu\n"
+                       "showdocs_connection_bytes %lu\n"
+                       "showdocs_io_buffers_active %lu\n"
+                       "showdocs_io_buffer_bytes %lu\n"
+                       "showdocs_pool_bytes %lu\n"
+                       "showdocs_request_arena_high_water_bytes %lu\n",
+                       g_cache.hits, g_cache.misses, g_cache.uncacheable, g_cache.stale, g_cache.evictions,
+                       lookups ? (double)g_cache.hits / (double)lookups : 0.0,
+                       g_cache.entries, (unsigned long)g_cache.bytes, (unsigned long)g_cache.capacity,
+                       g_rate_limiter.rejected,
+                       (unsigned long)g_connection_pool.in_use, (unsigned long)g_connection_pool.object_size,
+                       (unsigned long)g_io_buffer_pool.in_use, (unsigned long)g_io_buffer_pool.object_size,
+                       (unsigned long)(g_connection_pool.bytes + g_io_buffer_pool.bytes),
+                       (unsigned long)g_arena_high_water);
+    if (len < 0)
+        return 0;
+    return (size_t)len < max_len ? (size_t)len : max_len - 1;
+}
+
+// Handle incoming HTTP request
+int handle_request(Connection *conn, Config *config)
+{
+    RequestInfo *info = &conn->io->info;
+    Arena *arena = &conn->io->arena;
+    char *request = conn->io->request;
+    memset(request, 0, BUFFER_SIZE);
+
+    uint64_t phase_start = get_monotonic_us();
+    ssize_t bytes_received = recv(conn->sock, request, BUFFER_SIZE - 1, 0);
+    info->recv_us = (uint32_t)(get_monotonic_us() - phase_start);
+    trace_phase(&g_tracer, TRACE_RECV, phase_start);
+    if (bytes_received <= 0)
+        return 1;
+
+    uint64_t parse_start = trace_now(&g_tracer);
+
+    strtok(request, " ");
+    char *path = strtok(NULL, " ");
+
+    // If no path or path is "/", default to index.html
+    if (!path || strcmp(path, "/") == 0)
+    {
+        path = "index.html";
+    }
+    else if (path[0] == '/')
+    {
+        path++; // Remove leading '/'
+        url_decode_path(path);
+    }
+
+    log_request(LOG_INFO, "Request: %s", path);
+    strncpy(info->path, path, MAX_PATH_LEN - 1);
+    info->path[MAX_PATH_LEN - 1] = 0;
+
+    char *date_buffer = arena_alloc(arena, 128);
+    char *full_path = arena_alloc(arena, MAX_PATH_LEN);
+    if (!date_buffer || !full_path)
+    {
+        log_message(LOG_ERROR, "Request arena exhausted");
+        return 1;
+    }
+    get_gmt_date(date_buffer, 128);
+
+    trace_phase(&g_tracer, TRACE_PARSE, parse_start);
+
+    // Refuse paths that would resolve outside RootDir
+    if (!request_path_is_safe(path))
+    {
+        const char *body = "Bad Request\n";
+        phase_start = get_monotonic_us();
+        long bytes_sent = send_buffer_response(conn->sock, "HTTP/1.1 400 Bad Request", "text/plain",
+                                               body, strlen(body), date_buffer, arena);
+        info->send_us = (uint32_t)(get_monotonic_us() - phase_start);
+        info->status = 400;
+        info->bytes_sent = bytes_sent > 0 ? (uint64_t)bytes_sent : 0;
+        log_request(LOG_WARN, "400 Bad Request: %s", path);
+        return 1;
+    }
+
+    // Built-in endpoints
+    if (strcmp(path, "__showdocs/metrics") == 0)
+    {
+        char *metrics = arena_alloc(arena, 2048);
+        size_t metrics_len = metrics ? format_metrics(metrics, 2048) : 0;
+        phase_start = get_monotonic_us();
+        long bytes_sent = send_buffer_response(conn->sock, "HTTP/1.1 200 OK", "text/plain; version=0.0.4",
+                                               metrics, metrics_len, date_buffer, arena);
+        info->send_us = (uint32_t)(get_monotonic_us() - phase_start);
+        info->status = 200;
+        info->bytes_sent = bytes_sent > 0 ? (uint64_t)bytes_sent : 0;
+        log_request(LOG_INFO, "200 OK: %s", path);
+        return 1;
+    }
+
+    // Generated sidebar and site map, unless a real _sidebar.md exists
+    if (config->auto_sidebar && g_manifest.count > 0)
+    {
+        const StrBuf *generated = NULL;
+        const char *content_type = NULL;
+        struct stat st;
+        if (strcmp(path, "__showdocs/sitemap.json") == 0)
+        {
+            generated = &g_site_index.sitemap;
+            content_type = "application/json";
+        }
+        else if (strcmp(site_basename(path), "_sidebar.md") == 0)
+        {
+            build_full_path(config->root_dir, path, full_path, MAX_PATH_LEN);
+            if (stat(full_path, &st) != 0)
+            {
+                generated = &g_site_index.sidebar;
+                content_type = "text/markdown; charset=utf-8";
+            }
+        }
+
+        if (generated && g_site_index.valid)
+        {
+            phase_start = get_monotonic_us();
+            long bytes_sent = send_buffer_response(conn->sock, "HTTP/1.1 200 OK", content_type,
+                                                   generated->data, generated->len, date_buffer, arena);
+            info->send_us = (uint32_t)(get_monotonic_us() - phase_start);
+            info->status = 200;
+            info->bytes_sent = bytes_sent > 0 ? (uint64_t)bytes_sent : 0;
+            log_request(LOG_INFO, "200 OK (generated): %s", path);
+            return 1;
+        }
+    }
+
+    // Serve requested file or 404, from the cache when possible
+    phase_start = get_monotonic_us();
+    CacheEntry *entry = cache_acquire(&g_cache, config->root_dir, path);
+    FILE *fp = NULL;
+    if (!entry)
+    {
+        build_full_path(config->root_dir, path, full_path, MAX_PATH_LEN);
+        fp = fopen(full_path, "rb");
+    }
+    info->open_us = (uint32_t)(get_monotonic_us() - phase_start);
+    trace_phase(&g_tracer, TRACE_OPEN, phase_start);
+    if (entry || fp)
+    {
+        if (fp)
+            fclose(fp);
+        phase_start = get_monotonic_us();
+        long bytes_sent = entry ? send_buffer_response(conn->sock, "HTTP/1.1 200 OK", "text/html",
+                                                       entry->data, entry->size, date_buffer, arena)
+                                : send_http_response(conn->sock, "HTTP/1.1 200 OK", path, date_buffer,
+                                                     config->root_dir, arena);
+        cache_release(&g_cache, entry);
+        info->send_us = (uint32_t)(get_monotonic_us() - phase_start);
+        info->status = 200;
+        info->bytes_sent = bytes_sent > 0 ? (uint64_t)bytes_sent : 0;
+        manifest_record_access(&g_manifest, path);
+        if (config->auto_sidebar && manifest_check_page(&g_manifest, config->root_dir, path))
+            g_site_index.dirty = 1;
+        log_request(LOG_INFO, "200 OK: %s", path);
+    }
+    else
+    {
+        phase_start = get_monotonic_us();
+        entry = cache_acquire(&g_cache, config->root_dir, "404.html");
+        FILE *fp404 = NULL;
+        if (!entry)
+        {
+            build_full_path(config->root_dir, "404.html", full_path, MAX_PATH_LEN);
+            fp404 = fopen(full_path, "rb");
+        }
+        info->open_us += (uint32_t)(get_monotonic_us() - phase_start);
+        trace_phase(&g_tracer, TRACE_OPEN, phase_start);
+        if (entry || fp404)
+        {
+            if (fp404)
+                fclose(fp404);
+            phase_start = get_monotonic_us();
+            long bytes_sent = entry ? send_buffer_response(conn->sock, "HTTP/1.1 404 Not Found", "text/html",
+                                                           entry->data, entry->size, date_buffer, arena)
+                                    : send_http_response(conn->sock, "HTTP/1.1 404 Not Found", "404.html", date_buffer,
+                                                         config->root_dir, arena);
+            cache_release(&g_cache, entry);
+            info->send_us = (uint32_t)(get_monotonic_us() - phase_start);
+            info->status = 404;
+            info->bytes_sent = bytes_sent > 0 ? (uint64_t)bytes_sent : 0;
+            log_request(LOG_WARN, "404 Not Found: %s", path);
+        }
+        else
+        {
+            info->status = 404;
+            log_message(LOG_ERROR, "404 page not found and no 404.html available");
+        }
+    }
+
+    return 1; // Continue running
+}
+
+// Sends the file contents plus a built HTTP header for status_line.
+// Returns the number of bytes sent, or -1 if the file can't be opened.
+long send_http_response(int client_sock,
+                        const char *status_line,
+                        const char *filename,
+                        const char *date_str,
+                        const char *root_dir,
+                        Arena *arena)
+{
+    uint64_t phase_start = trace_now(&g_tracer);
+
+    // Scratch buffers come from the request arena
+    char *full_path = arena_alloc(arena, MAX_PATH_LEN);
+    char *header = arena_alloc(arena, 512);
+    char *file_buffer = arena_alloc(arena, BUFFER_SIZE);
+    if (!full_path || !header || !file_buffer)
+    {
+        return -1;
+    }
+
+    // Build full path with root directory
+    build_full_path(root_dir, filename, full_path, MAX_PATH_LEN);
+
+    // Attempt to open the file
+    FILE *fp = fopen(full_path, "rb");
+    if (!fp)
+    {
+        // If file can't be opened, return
+        return -1;
+    }
+
+    // Finds file size
+    fseek(fp, 0, SEEK_END);
+    long file_size = ftell(fp);
+    rewind(fp);
+    trace_phase(&g_tracer, TRACE_SEND_OPEN, phase_start);
+
+    // Builds header string
+    snprintf(header, 512,
+             "%s\r\n"
+             "Content-Type: text/html\r\n"
+             "Date: %s\r\n"
+             "Content-Length: %ld\r\n"
+             "\r\n",
+             status_line, date_str, file_size);
+
+    // Sends header
+    phase_start = trace_now(&g_tracer);
+    long bytes_sent = 0;
+    if (send(client_sock, header, strlen(header), 0) > 0)
+        bytes_sent += (long)strlen(header);
+    trace_phase(&g_tracer, TRACE_SEND_HEADER, phase_start);
+    phase_start = trace_now(&g_tracer);
+
+    // Sendsfile contents
+    size_t bytes_read;
+    int send_failed = 0;
+    while (!send_failed && (bytes_read = fread(file_buffer, 1, BUFFER_SIZE, fp)) > 0)
+    {
+        // send() may accept less than asked for, so loop until the chunk is out
+        size_t offset = 0;
+        while (offset < bytes_read)
+        {
+            int sent = (int)send(client_sock, file_buffer + offset, (int)(bytes_read - offset), 0);
+            if (sent <= 0)
+            {
+                send_failed = 1;
+                break;
+            }
+            offset += (size_t)sent;
+        }
+        bytes_sent += (long)offset;
+    }
+
+    fclose(fp);
+    trace_phase(&g_tracer, TRACE_SEND_BODY, phase_start);
+    return bytes_sent;
+}
+
+// Sends an in-memory body plus a built HTTP header for status_line.
+// Returns the number of bytes sent.
+long send_buffer_response(int client_sock,
+                          const char *status_line,
+                          const char *content_type,
+                          const char *data,
+                          size_t size,
+                          const char *date_str,
+                          Arena *arena)
+{
+    char *header = arena_alloc(arena, 512);
+    if (!header)
+    {
+        return -1;
+    }
+    snprintf(header, 512,
+             "%s\r\n"
+             "Content-Type: %s\r\n"
+             "Date: %s\r\n"
+             "Content-Length: %lu\r\n"
+             "\r\n",
+             status_line, content_type, date_str, (unsigned long)size);
+
+    uint64_t phase_start = trace_now(&g_tracer);
+    long bytes_sent = 0;
+    if (send(client_sock, header, strlen(header), 0) > 0)
+        bytes_sent += (long)strlen(header);
+    trace_phase(&g_tracer, TRACE_SEND_HEADER, phase_start);
+    phase_start = trace_now(&g_tracer);
+
+    // send() may accept less than asked for, so loop until the body is out
+    size_t offset = 0;
+    while (offset < size)
+    {
+        size_t chunk = size - offset < 65536 ? size - offset : 65536;
+        int sent = (int)send(client_sock, data + offset, (int)chunk, 0);
+        if (sent <= 0)
+            break;
+        offset += (size_t)sent;
+    }
+    bytes_sent += (long)offset;
+
+    trace_phase(&g_tracer, TRACE_SEND_BODY, phase_start);
+    return bytes_sent;
+}
+
+int main(int argc, char *argv[])
+{
+    print_version();
+
+    // Offline analysis of a binary access log, no server is started
+    if (argc > 1 && strcmp(argv[1], "--analyze") == 0)
+    {
+        if (argc < 3)
+        {
+            fprintf(stderr, "Usage: %s --analyze <access log>\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+        return analyze_access_log(argv[2]);
+    }
+
+    init_networking();
+
+    Config config;
+    init_config(&config);
+    load_config(&config, argc, argv);
+
+    g_server_sock = create_server_socket(&config);
+
+    // Setup signal handlers for graceful shutdown
+    setup_signal_handlers();
+
+    rate_limit_init(&g_rate_limiter, &config);
+
+    g_tracer.sample = config.trace_sample;
+    if (config.trace_enabled)
+    {
+        trace_set_enabled(&g_tracer, 1, config.trace_file);
+    }
+
+    if (config.access_log[0])
+    {
+        if (access_log_open(&g_access_log, config.access_log, (uint64_t)config.access_log_records))
+        {
+            log_message(LOG_INFO, "Access log: %s (%d records)", config.access_log, config.access_log_records);
+        }
+        else
+        {
+            log_message(LOG_WARN, "Failed to open access log: %s", config.access_log);
+        }
+    }
+
+    cache_init(&g_cache, &config);
+    connection_pools_init();
+
+    // Scan RootDir and warm up the most requested files
+    if (config.manifest_enabled || config.auto_sidebar)
+    {
+        manifest_init(&g_manifest, &config);
+    }
+    if (config.auto_sidebar && g_manifest.count > 0)
+    {
+        g_site_index.last_check_us = get_monotonic_us();
+        site_index_build(&g_site_index, &g_manifest);
+    }
+
+    const char *exec_cmd = get_exec_command(&config);
+    execute_startup_command(exec_cmd);
+
+    // Main server loop
+    while (g_run)
+    {
+        // Use select() with timeout to allow checking g_run periodically
+        fd_set read_fds;
+        FD_ZERO(&read_fds);
+        FD_SET(g_server_sock, &read_fds);
+
+        struct timeval timeout;
+        timeout.tv_sec = 1; // 1 second timeout
+        timeout.tv_usec = 0;
+
+        int select_result = select(g_server_sock + 1, &read_fds, NULL, NULL, &timeout);
+
+#ifndef _WIN32
+        if (g_trace_toggle)
+        {
+            g_trace_toggle = 0;
+            trace_set_enabled(&g_tracer, !g_tracer.enabled, config.trace_file);
+        }
+#endif
+
+        if (select_result < 0)
         {
             if (!g_run)
                 break; // Interrupted by signal
+#ifndef _WIN32
+            if (errno == EINTR)
+                continue; // Interrupted by SIGUSR1
+#endif
             log_message(LOG_ERROR, "Select failed");
             break;
         }
 
         if (select_result == 0)
         {
-            // Timeout - check if we should continue running
+            // Timeout - check if we should continue running, and use the idle
+            // time to save the access log header and pick up changes under RootDir
+            access_log_sync(&g_access_log);
+            if (config.auto_sidebar && g_manifest.count > 0)
+                site_index_update(&g_site_index, &g_manifest, config.root_dir, SITE_INDEX_CHECK_US);
             continue;
         }
 
         // Socket is ready for accept
+        trace_start_request(&g_tracer);
+        uint64_t accept_start = trace_now(&g_tracer);
         struct sockaddr_in client_addr;
         socklen_t client_len = sizeof(client_addr);
 #ifdef _WIN32
@@ -792,18 +3626,76 @@ int main(int argc, char *argv[])
         {
             if (!g_run)
                 break; // Interrupted by signal
+            if (errno == EINTR)
+                continue;
 #endif
             log_message(LOG_ERROR, "Accept failed");
             break;
         }
 
-        if (!handle_request(client_sock, &config))
+        trace_phase(&g_tracer, TRACE_ACCEPT, accept_start);
+
+        Connection *conn = connection_open(client_sock, &client_addr);
+        if (!conn)
+        {
+            log_message(LOG_ERROR, "Out of connection objects, dropping client");
+            close(client_sock);
+            continue;
+        }
+        if (!connection_begin_request(conn))
+        {
+            log_message(LOG_ERROR, "Out of I/O buffers, dropping request");
+            close(client_sock);
+            connection_free(conn);
+            continue;
+        }
+        RequestInfo *info = &conn->io->info;
+        uint64_t timestamp_us = get_wall_clock_us();
+
+        int retry_after = 0;
+        int allowed = rate_limit_allow(&g_rate_limiter, info->client_addr, &retry_after);
+        trace_phase(&g_tracer, TRACE_RATE_LIMIT, info->start_us);
+        if (!allowed)
+        {
+            send_rate_limited_response(client_sock, retry_after);
+            log_request(LOG_WARN, "429 Too Many Requests: %s", inet_ntoa(client_addr.sin_addr));
+            info->status = 429;
+        }
+        else if (!handle_request(conn, &config))
         {
             g_run = 0;
         }
+
+        uint64_t close_start = trace_now(&g_tracer);
         close(client_sock);
+        trace_phase(&g_tracer, TRACE_CLOSE, close_start);
+        trace_end_request(&g_tracer, info);
+        access_log_write(&g_access_log, info, timestamp_us,
+                         (uint32_t)(get_monotonic_us() - info->start_us));
+        connection_end_request(conn);
+        connection_free(conn);
+
+        // A busy server never reaches the select() timeout
+        if (config.auto_sidebar && g_manifest.count > 0)
+            site_index_update(&g_site_index, &g_manifest, config.root_dir, SITE_INDEX_BUSY_CHECK_US);
     } // Cleanup
     log_message(LOG_INFO, "Server shutting down...");
+    access_log_close(&g_access_log);
+    trace_set_enabled(&g_tracer, 0, config.trace_file);
+    free(g_tracer.events);
+    cache_destroy(&g_cache);
+    connection_pools_destroy();
+    if (g_rate_limiter.rejected > 0)
+    {
+        log_message(LOG_INFO, "Rate limited %lu requests", g_rate_limiter.rejected);
+    }
+    if (config.manifest_enabled && g_manifest.count > 0)
+    {
+        // Persist access counts for the next warm start
+        manifest_save(&g_manifest, config.manifest_file, config.root_dir);
+    }
+    manifest_free(&g_manifest);
+    site_index_free(&g_site_index);
 #ifdef _WIN32
     if (g_server_sock != INVALID_SOCKET)
     {